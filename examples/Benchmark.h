@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+// Shared by the benchmark examples, each of them only adds its own
+// corpora and what it measures. All corpus generators produce valid
+// expressions of at least nSize bytes.
+
+// Small deterministic generator, every run uses the exact same corpora
+class Random {
+public:
+	Random(uint32_t nSeed) : m_nState(nSeed) { }
+
+	uint32_t Next(uint32_t nMax)
+	{
+		// xorshift32
+		m_nState ^= m_nState << 13;
+		m_nState ^= m_nState >> 17;
+		m_nState ^= m_nState << 5;
+		return m_nState % nMax;
+	}
+
+private:
+	uint32_t m_nState;
+};
+
+// Appends numbers without leading zeros in the range [1, nMax]
+inline void AppendNumber(std::string& sScript, Random& rand, uint32_t nMax)
+{
+	sScript += std::to_string(rand.Next(nMax) + 1);
+}
+
+// Reads the optional [script size] [runs] arguments, the script size is
+// given in multiples of nSizeUnit bytes
+inline void ReadArguments(int argc, char* argv[], size_t nSizeUnit, size_t& nScriptSize, int& nRuns)
+{
+	if (argc > 1)
+		nScriptSize = size_t(std::max(1.0, std::atof(argv[1]) * double(nSizeUnit)));
+
+	if (argc > 2)
+		nRuns = std::max(1, std::atoi(argv[2]));
+}
+
+// Calls run nRuns times and returns the fastest call in seconds. Returns 0
+// as soon as a call returns false.
+template<typename Run>
+double MeasureBest(int nRuns, Run&& run)
+{
+	double fBest = 0.0;
+
+	for (int i = 0; i < nRuns; i++) {
+		auto tpStart = std::chrono::high_resolution_clock::now();
+
+		if (!run())
+			return 0.0;
+
+		auto tpEnd = std::chrono::high_resolution_clock::now();
+
+		double fElapsed = std::chrono::duration<double>(tpEnd - tpStart).count();
+		if (i == 0 || fElapsed < fBest)
+			fBest = fElapsed;
+	}
+
+	return fBest;
+}
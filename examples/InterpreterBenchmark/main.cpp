@@ -0,0 +1,137 @@
+#include "../olcPGE.h"
+#include "../Benchmark.h"
+
+#include <functional>
+
+// Usage: InterpreterBenchmark [script size in KiB] [evaluations per measurement]
+
+// Divisors are always literals, so no corpus divides by zero
+std::string GenerateSumOfProducts(size_t nSize)
+{
+	Random rand(1);
+	std::string sScript;
+	sScript.reserve(nSize + 16);
+
+	AppendNumber(sScript, rand, 9);
+	while (sScript.size() < nSize) {
+		sScript += rand.Next(2) == 0 ? "+" : "-";
+		AppendNumber(sScript, rand, 9);
+		sScript += rand.Next(2) == 0 ? "*" : "/";
+		AppendNumber(sScript, rand, 9);
+	}
+
+	return sScript;
+}
+
+std::string GenerateNested(size_t nSize)
+{
+	const int nDepth = 32;
+	Random rand(2);
+	std::string sScript;
+	sScript.reserve(nSize + 512);
+
+	while (sScript.size() < nSize) {
+		if (!sScript.empty())
+			sScript += "+";
+
+		for (int i = 0; i < nDepth; i++) {
+			AppendNumber(sScript, rand, 9);
+			sScript += rand.Next(2) == 0 ? "-(" : "+-(";
+		}
+
+		AppendNumber(sScript, rand, 9);
+		sScript.append(nDepth, ')');
+	}
+
+	return sScript;
+}
+
+std::string GenerateFormula(size_t)
+{
+	// Typical per entity formula, evaluated many times
+	return "(10 + 2 * 3) * 4 - 20 / (1 + 4) + -(7 - 3) * 2";
+}
+
+// Keeps the fastest of three runs of nEvaluations evaluations
+double Measure(const std::function<int()>& evaluate, int nEvaluations, int& nResult)
+{
+	return MeasureBest(3, [&]() {
+		for (int i = 0; i < nEvaluations; i++)
+			nResult = evaluate();
+
+		return true;
+	});
+}
+
+int main(int argc, char* argv[])
+{
+	size_t nScriptSize = 256 * 1024;
+	int nEvaluations = 20;
+
+	ReadArguments(argc, argv, 1024, nScriptSize, nEvaluations);
+
+	struct Corpus {
+		std::string sName;
+		std::string sScript;
+		int nEvaluations;
+	};
+
+	std::vector<Corpus> vCorpora = {
+		{ "sum of products", GenerateSumOfProducts(nScriptSize), nEvaluations },
+		{ "nested", GenerateNested(nScriptSize), nEvaluations },
+		{ "formula", GenerateFormula(nScriptSize), nEvaluations * 100000 }
+	};
+
+	std::cout << "Constant folding is off, every node is evaluated" << std::endl;
+#if defined(OLC_SCRIPT_COMPUTED_GOTO)
+	std::cout << "VM dispatch: computed goto" << std::endl;
+#else
+	std::cout << "VM dispatch: switch" << std::endl;
+#endif
+
+	for (auto& corpus : vCorpora) {
+		olc::script::InternTable internTable;
+		olc::script::TokenizerReturn tokens = olc::script::Lexer(corpus.sScript, internTable).Tokenize();
+		if (std::holds_alternative<olc::script::Error>(tokens)) {
+			std::cout << "Error lexing script: " << std::get<olc::script::Error>(tokens) << std::endl;
+			continue;
+		}
+
+		olc::script::Parser parser(std::get<olc::script::TokenBuffer>(tokens));
+		parser.SetConstantFolding(false);
+		olc::script::ParserReturn ast = parser.Parse();
+		if (!ast.HasValue()) {
+			std::cout << "Error parsing script: " << ast.GetError() << std::endl;
+			continue;
+		}
+
+		olc::script::FlatAST flat = ast.GetValue().Flatten();
+		olc::script::Bytecode bytecode(flat);
+		olc::script::RegisterCode registerCode(flat);
+		std::vector<int32_t> vScratch;
+
+		std::vector<std::pair<std::string, std::function<int()>>> vTiers = {
+			{ "Tree walker", [&]() { return ast.GetValue().Interpret(); } },
+			{ "Flat AST", [&]() { return flat.Interpret(vScratch); } },
+			{ "Stack VM", [&]() { return bytecode.Run(vScratch); } },
+			{ "Register VM", [&]() { return registerCode.Run(vScratch); } }
+		};
+
+		std::cout << std::endl << "Corpus '" << corpus.sName << "' (" << flat.GetSize() << " nodes, "
+			<< bytecode.GetInstructions().size() << " stack instructions, "
+			<< registerCode.GetInstructions().size() << " register instructions)" << std::endl;
+
+		for (auto& tier : vTiers) {
+			int nResult = 0;
+			double fSeconds = Measure(tier.second, corpus.nEvaluations, nResult);
+			double fNodes = double(flat.GetSize()) * corpus.nEvaluations;
+
+			std::cout << "  " << tier.first << ": "
+				<< fSeconds * 1000.0 << " ms, "
+				<< fNodes / fSeconds / 1000000.0 << " M nodes/s"
+				<< " (result " << nResult << ")" << std::endl;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,176 @@
+#include "../olcPGE.h"
+#include "../Benchmark.h"
+
+// Usage: LexerBenchmark [script size in MiB] [runs per measurement]
+
+std::string GenerateDeepParens(size_t nSize)
+{
+	const int nDepth = 64;
+	Random rand(1);
+	std::string sScript;
+	sScript.reserve(nSize + 256);
+
+	while (sScript.size() < nSize) {
+		if (!sScript.empty())
+			sScript += " + ";
+
+		sScript.append(nDepth, '(');
+		AppendNumber(sScript, rand, 1000);
+		sScript.append(nDepth, ')');
+	}
+
+	return sScript;
+}
+
+std::string GenerateLongSum(size_t nSize)
+{
+	Random rand(2);
+	std::string sScript;
+	sScript.reserve(nSize + 16);
+
+	AppendNumber(sScript, rand, 100);
+	while (sScript.size() < nSize) {
+		sScript += rand.Next(2) == 0 ? " + " : " - ";
+		AppendNumber(sScript, rand, 100);
+	}
+
+	return sScript;
+}
+
+std::string GenerateHugeLiterals(size_t nSize)
+{
+	const char* operators[] = { " * ", " / ", " + ", " - " };
+	Random rand(3);
+	std::string sScript;
+	sScript.reserve(nSize + 32);
+
+	// 10 digit literals close to the 32-bit limit
+	AppendNumber(sScript, rand, 2147483647 - 1000000000);
+	while (sScript.size() < nSize) {
+		sScript += operators[rand.Next(4)];
+		sScript += std::to_string(1000000000 + rand.Next(2147483647 - 1000000000));
+	}
+
+	return sScript;
+}
+
+std::string GenerateWhitespace(size_t nSize)
+{
+	const char whitespaces[] = { ' ', ' ', ' ', '\t', '\n' };
+	Random rand(4);
+	std::string sScript;
+	sScript.reserve(nSize + 256);
+
+	AppendNumber(sScript, rand, 10);
+	while (sScript.size() < nSize) {
+		uint32_t nRun = 16 + rand.Next(112);
+		for (uint32_t i = 0; i < nRun; i++)
+			sScript += whitespaces[rand.Next(5)];
+
+		sScript += "+";
+		AppendNumber(sScript, rand, 10);
+	}
+
+	return sScript;
+}
+
+std::string GenerateIdentifiers(size_t nSize)
+{
+	const char* names[] = { "health", "damage", "armor_class", "fSpeed", "nLevel", "_bonus", "critical_hit_multiplier" };
+	Random rand(5);
+	std::string sScript;
+	sScript.reserve(nSize + 32);
+
+	sScript += names[rand.Next(7)];
+	while (sScript.size() < nSize) {
+		sScript += rand.Next(2) == 0 ? " * " : " + ";
+		sScript += names[rand.Next(7)];
+	}
+
+	return sScript;
+}
+
+struct Measurement {
+	double fSeconds = 0.0;
+	size_t nTokens = 0;
+};
+
+// Pulls every token through GetNextToken and keeps the fastest of nRuns
+Measurement MeasureGetNextToken(const std::string& sScript, int nRuns)
+{
+	Measurement measurement;
+
+	measurement.fSeconds = MeasureBest(nRuns, [&]() {
+		olc::script::InternTable internTable;
+		olc::script::Lexer lexer(sScript, internTable);
+
+		measurement.nTokens = 0;
+		while (true) {
+			olc::script::LexerReturn ret = lexer.GetNextToken();
+			if (std::holds_alternative<olc::script::Error>(ret)) {
+				std::cout << "Error lexing script: " << std::get<olc::script::Error>(ret) << std::endl;
+				return false;
+			}
+
+			measurement.nTokens++;
+			if (std::get<olc::script::Token>(ret).GetTokenType() == olc::script::TokenType::TT_EOF)
+				return true;
+		}
+	});
+
+	return measurement;
+}
+
+const char* GetSimdLevelName(olc::script::SimdLevel level)
+{
+	switch (level) {
+	case olc::script::SimdLevel::SIMD_SSE2:
+		return "SSE2";
+
+	case olc::script::SimdLevel::SIMD_AVX2:
+		return "AVX2";
+
+	default:
+		return "Scalar";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t nScriptSize = 16 * 1024 * 1024;
+	int nRuns = 5;
+
+	ReadArguments(argc, argv, 1024 * 1024, nScriptSize, nRuns);
+
+	std::vector<std::pair<std::string, std::string>> vCorpora = {
+		{ "deep parens", GenerateDeepParens(nScriptSize) },
+		{ "long sum", GenerateLongSum(nScriptSize) },
+		{ "huge literals", GenerateHugeLiterals(nScriptSize) },
+		{ "whitespace", GenerateWhitespace(nScriptSize) },
+		{ "identifiers", GenerateIdentifiers(nScriptSize) }
+	};
+
+	olc::script::SimdLevel detected = olc::script::DetectSimdLevel();
+	std::cout << "Detected SIMD level: " << GetSimdLevelName(detected) << std::endl;
+	std::cout << "Best of " << nRuns << " runs" << std::endl;
+
+	for (auto& corpus : vCorpora) {
+		std::cout << std::endl << "Corpus '" << corpus.first << "' (" << corpus.second.size() << " bytes)" << std::endl;
+
+		for (int level = 0; level <= int(detected); level++) {
+			olc::script::SimdLevel used = olc::script::SetSimdLevel(olc::script::SimdLevel(level));
+			Measurement measurement = MeasureGetNextToken(corpus.second, nRuns);
+			if (measurement.fSeconds <= 0.0)
+				continue;
+
+			double fMBPerSecond = double(corpus.second.size()) / measurement.fSeconds / (1024.0 * 1024.0);
+			double fMTokensPerSecond = double(measurement.nTokens) / measurement.fSeconds / 1000000.0;
+			std::cout << "  " << GetSimdLevelName(used) << ": "
+				<< fMBPerSecond << " MB/s, "
+				<< fMTokensPerSecond << " M tokens/s" << std::endl;
+		}
+	}
+
+	olc::script::SetSimdLevel(detected);
+	return 0;
+}
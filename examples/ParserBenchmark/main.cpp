@@ -0,0 +1,155 @@
+#include "../olcPGE.h"
+#include "../Benchmark.h"
+
+// Usage: ParserBenchmark [script size in MiB] [runs per measurement]
+
+std::string GenerateLongSum(size_t nSize)
+{
+	Random rand(1);
+	std::string sScript;
+	sScript.reserve(nSize + 16);
+
+	AppendNumber(sScript, rand, 100);
+	while (sScript.size() < nSize) {
+		sScript += rand.Next(2) == 0 ? "+" : "-";
+		AppendNumber(sScript, rand, 100);
+	}
+
+	return sScript;
+}
+
+// The generators keep every subexpression inside of 32 bits, folding would
+// report an ArithmeticOverflowError otherwise. Every addition or subtraction
+// of a whole term picks the sign that moves the sum towards zero.
+std::string GenerateDeepParens(size_t nSize)
+{
+	const int nDepth = 256;
+	Random rand(2);
+	std::string sScript;
+	sScript.reserve(nSize + 1024);
+	int64_t nSum = 0;
+
+	while (sScript.size() < nSize) {
+		// Only ones are multiplied, so a group stays below 10 * nDepth
+		int64_t vDigits[nDepth + 1];
+		bool vMultiply[nDepth];
+		for (int i = 0; i < nDepth; i++) {
+			vMultiply[i] = rand.Next(2) == 0;
+			vDigits[i] = vMultiply[i] ? 1 : rand.Next(9) + 1;
+		}
+		vDigits[nDepth] = rand.Next(9) + 1;
+
+		int64_t nGroup = vDigits[nDepth];
+		for (int i = nDepth - 1; i >= 0; i--)
+			nGroup = vMultiply[i] ? vDigits[i] * nGroup : vDigits[i] - nGroup;
+
+		if (!sScript.empty())
+			sScript += (nSum > 0) == (nGroup > 0) ? "-" : "+";
+		nSum += (sScript.empty() || sScript.back() == '+') ? nGroup : -nGroup;
+
+		for (int i = 0; i < nDepth; i++) {
+			sScript += std::to_string(vDigits[i]);
+			sScript += vMultiply[i] ? "*(" : "-(";
+		}
+
+		sScript += std::to_string(vDigits[nDepth]);
+		sScript.append(nDepth, ')');
+	}
+
+	return sScript;
+}
+
+std::string GenerateMixedPrecedence(size_t nSize)
+{
+	Random rand(3);
+	std::string sScript;
+	sScript.reserve(nSize + 64);
+	int64_t nSum = 0;
+
+	while (sScript.size() < nSize) {
+		// Products of up to three factors in [-100, 100]
+		std::string sTerm;
+		int64_t nTerm = 0;
+		uint32_t nFactors = 1 + rand.Next(3);
+		for (uint32_t i = 0; i < nFactors; i++) {
+			bool bMultiply = rand.Next(2) == 0;
+			if (i > 0)
+				sTerm += bMultiply ? "*" : "/";
+
+			int64_t nFactor = rand.Next(100) + 1;
+			if (i > 0 && rand.Next(4) == 0) {
+				sTerm += "-";
+				nFactor = -nFactor;
+			}
+
+			sTerm += std::to_string(nFactor < 0 ? -nFactor : nFactor);
+			nTerm = i == 0 ? nFactor : bMultiply ? nTerm * nFactor : nTerm / nFactor;
+		}
+
+		bool bSubtract = !sScript.empty() && (nSum > 0) == (nTerm > 0);
+		if (!sScript.empty())
+			sScript += bSubtract ? "-" : "+";
+
+		sScript += sTerm;
+		nSum += bSubtract ? -nTerm : nTerm;
+	}
+
+	return sScript;
+}
+
+// Keeps the fastest of nRuns parses of the same token buffer
+double MeasureParse(const olc::script::TokenBuffer& vTokens, bool bConstantFolding, int nRuns)
+{
+	return MeasureBest(nRuns, [&]() {
+		olc::script::Parser parser(vTokens);
+		parser.SetConstantFolding(bConstantFolding);
+		olc::script::ParserReturn ret = parser.Parse();
+
+		if (!ret.HasValue()) {
+			std::cout << "Error parsing script: " << ret.GetError() << std::endl;
+			return false;
+		}
+
+		return true;
+	});
+}
+
+int main(int argc, char* argv[])
+{
+	size_t nScriptSize = 16 * 1024 * 1024;
+	int nRuns = 5;
+
+	ReadArguments(argc, argv, 1024 * 1024, nScriptSize, nRuns);
+
+	std::vector<std::pair<std::string, std::string>> vCorpora = {
+		{ "long sum", GenerateLongSum(nScriptSize) },
+		{ "deep parens", GenerateDeepParens(nScriptSize) },
+		{ "mixed precedence", GenerateMixedPrecedence(nScriptSize) }
+	};
+
+	std::cout << "Best of " << nRuns << " runs" << std::endl;
+
+	for (auto& corpus : vCorpora) {
+		olc::script::InternTable internTable;
+		olc::script::TokenizerReturn tokens = olc::script::Lexer(corpus.second, internTable).Tokenize();
+		if (std::holds_alternative<olc::script::Error>(tokens)) {
+			std::cout << "Error lexing script: " << std::get<olc::script::Error>(tokens) << std::endl;
+			continue;
+		}
+
+		const olc::script::TokenBuffer& vTokens = std::get<olc::script::TokenBuffer>(tokens);
+		std::cout << std::endl << "Corpus '" << corpus.first << "' (" << vTokens.size() << " tokens)" << std::endl;
+
+		for (bool bConstantFolding : { false, true }) {
+			double fSeconds = MeasureParse(vTokens, bConstantFolding, nRuns);
+			if (fSeconds <= 0.0)
+				continue;
+
+			std::cout << "  " << (bConstantFolding ? "Folding" : "No folding") << ": "
+				<< fSeconds * 1000.0 << " ms, "
+				<< double(vTokens.size()) / fSeconds / 1000000.0 << " M tokens/s" << std::endl;
+		}
+	}
+
+	return 0;
+}
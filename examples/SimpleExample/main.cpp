@@ -71,6 +71,35 @@ public:
 		std::cout << "Expected: IllegalCharError" << std::endl;
 		std::cout << std::endl;
 
+		example = "1 / (2 - 2)";
+		script.LoadScript(example);
+		std::cout << "Expected: DivisionByZeroError" << std::endl;
+		std::cout << std::endl;
+
+		// Compiled scripts are parsed once and can be run every frame
+		olc::script::CompilerReturn compiled = script.Compile("2 * (5 + 5)");
+		if (compiled.HasValue())
+			std::cout << "Compiled Result: " << script.Run(compiled.GetValue()) << std::endl;
+		std::cout << "Expected: 20" << std::endl;
+		std::cout << std::endl;
+
+		// Constant scripts are checked and evaluated by the compiler
+		constexpr olc::script::ConstantResult constant = olc::script::EvaluateConstant("10 / 5 + 5 * 20");
+		static_assert(constant.IsValid(), "Constant script is invalid");
+		std::cout << "Constant Result: " << constant.nValue << std::endl;
+		std::cout << "Expected: 102" << std::endl;
+		std::cout << std::endl;
+
+		// Both report the first error of the script, lexer errors come first
+		constexpr olc::script::ConstantResult invalid = olc::script::EvaluateConstant(")abc(/-0's'");
+		static_assert(invalid.code == olc::script::ErrorCode::EC_LEADING_ZERO && invalid.span.nOffset == 7,
+			"Constant and runtime errors differ");
+		olc::script::CompilerReturn invalidCompiled = script.Compile(")abc(/-0's'");
+		if (!invalidCompiled.HasValue())
+			std::cout << "Runtime Error: " << invalidCompiled.GetError() << std::endl;
+		std::cout << "Constant Error: " << invalid.GetError() << std::endl;
+		std::cout << std::endl;
+
 		return true;
 	}
 
@@ -22,9 +22,15 @@
 	Grammar Definition
 	~~~~~~~~~~~~~~~~~~
 
-	expr	: term ((PLUS|MINUS) term)*
-	term	: factor ((MULTIPLY|DIVIDE) factor)*
-	factor	: (PLUS|MINUS) factor | NUMBER | LPAREN expr RPAREN
+	expr	: operand (BINARY_OP operand)*
+	operand	: UNARY_OP operand | NUMBER | LPAREN expr RPAREN
+
+	The grammar doesn't hard-wire precedence levels. Which tokens are
+	unary and binary operators, their precedence and associativity
+	come from s_operatorTable, read by both the Parser and
+	EvaluateConstant. Currently unary PLUS and MINUS bind tightest,
+	followed by MULTIPLY and DIVIDE, then PLUS and MINUS, all left
+	associative.
 
 
 
@@ -33,7 +39,35 @@
 
 	Currently there are only integers in the decimal system allowed.
 	An integer can't start with the digit 0.
-	Integers are stored in 32-bit signed variables
+	Integers are stored in 32-bit signed variables, literals outside
+	of that range are reported as IntegerOverflowError
+
+
+
+	Identifiers and strings
+	~~~~~~~~~~~~~~~~~~~~~~~
+
+	Identifiers start with a letter or an underscore, followed by any
+	number of letters, digits and underscores. Strings are enclosed in
+	single quotes, can't span multiple lines and have no escape
+	sequences yet. Both are interned, equal names share one id.
+
+
+
+	Compile time evaluation
+	~~~~~~~~~~~~~~~~~~~~~~~
+
+	Scripts made only of literals can be evaluated by the compiler with
+	olc::script::EvaluateConstant. Combined with a static_assert on
+	IsValid() an invalid script becomes a compile error.
+
+
+	Large script files
+	~~~~~~~~~~~~~~~~~~
+
+	Script files are memory mapped and lexed in parallel with
+	Lexer::TokenizeParallel. The file is split at line breaks since no
+	token can span more than one line.
 
 
 
@@ -92,10 +126,59 @@
 #include "olcPixelGameEngine.h"
 
 #include <sstream>
+#include <string_view>
 #include <variant>
 #include <optional>
 #include <ctype.h>
 #include <iterator>
+#include <array>
+#include <charconv>
+#include <type_traits>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <new>
+#include <utility>
+#include <unordered_map>
+#include <list>
+#include <thread>
+#include <algorithm>
+#include <cassert>
+
+// SSE2 is part of every x64 target, AVX2 is only used after the CPU
+// reported support for it at runtime
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define OLC_SCRIPT_SIMD_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define OLC_SCRIPT_TARGET_AVX2
+	#else
+		#define OLC_SCRIPT_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+// Script files are memory mapped where the platform allows it
+#if defined(_WIN32)
+	#define OLC_SCRIPT_MMAP_WIN32
+	#if !defined(NOMINMAX)
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#elif defined(__linux__) || defined(__APPLE__)
+	#define OLC_SCRIPT_MMAP_POSIX
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+// GCC and Clang dispatch VM instructions through a table of label addresses,
+// MSVC has no labels as values and falls back to a switch. Define
+// OLC_SCRIPT_NO_COMPUTED_GOTO to force the switch everywhere.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(OLC_SCRIPT_NO_COMPUTED_GOTO)
+	#define OLC_SCRIPT_COMPUTED_GOTO
+#endif
 #pragma endregion
 
 // O--------------------------------------------------------------------------O
@@ -103,32 +186,46 @@
 // O--------------------------------------------------------------------------O
 #pragma region pgex_script_declaration
 namespace olc {
-	/****************/
-	/* Class Script */
-	/****************/
-	class ScriptEngine : olc::PGEX {
-	public: 
-		ScriptEngine() = default;
-
-	public:
-		bool LoadScript(std::string sScript);
-	};
-
 	namespace script {
 		// Forward declarations for typedefs
 		class Token;
 		class Error;
 		class ASTNode;
-
-		using ASTNodeSharedPtr = std::shared_ptr<ASTNode>;
-		using TokenValue = std::variant<std::monostate, int32_t>;
+		class AST;
+		class FlatAST;
+		class Bytecode;
+		class RegisterCode;
+		class CompiledScript;
+		template<typename T> class Expected;
+
+		using TokenBuffer = std::vector<Token>;
 		using LexerReturn = std::variant<Token, Error>;
-		using ParserReturn = std::variant<ASTNodeSharedPtr, Error>;
+		using TokenizerReturn = std::variant<TokenBuffer, Error>;
+		using NodeReturn = Expected<ASTNode*>;
+		using ParserReturn = Expected<AST>;
+		using CompilerReturn = Expected<CompiledScript>;
+
+		/******************/
+		/* Enum SimdLevel */
+		/******************/
+		// Instruction set used by the lexer to skip whitespace and digit runs
+		enum class SimdLevel {
+			SIMD_SCALAR,
+			SIMD_SSE2,
+			SIMD_AVX2
+		};
+
+		// Highest level supported by the compiler and the running CPU
+		SimdLevel DetectSimdLevel();
+		SimdLevel GetSimdLevel();
+		// Selects the level used by all lexers, levels not supported by the
+		// running CPU are clamped to the detected level. Returns the level in use.
+		SimdLevel SetSimdLevel(SimdLevel level);
 
 		/******************/
 		/* Enum TokenType */
 		/******************/
-		enum class TokenType {
+		enum class TokenType : uint8_t {
 			TT_NONE,
 			TT_PLUS,
 			TT_MINUS,
@@ -137,40 +234,217 @@ namespace olc {
 			TT_LPAREN,
 			TT_RPAREN,
 			TT_EOF,
-			TT_NUMBER
+			TT_NUMBER,
+			TT_IDENTIFIER,
+			TT_STRING
+		};
+
+		std::ostream& operator<<(std::ostream& os, TokenType type);
+
+		/******************/
+		/* Enum CharClass */
+		/******************/
+		enum class CharClass : uint8_t {
+			CC_ILLEGAL,
+			CC_END,
+			CC_WHITESPACE,
+			CC_DIGIT,
+			CC_PUNCTUATOR,
+			CC_IDENTIFIER,
+			CC_QUOTE
+		};
+
+		// Lexer lookup entry of a single character, tokenType is only set
+		// for punctuators which directly become a token
+		struct CharInfo {
+			CharClass charClass;
+			TokenType tokenType;
+		};
+
+		constexpr std::array<CharInfo, 256> BuildCharTable()
+		{
+			std::array<CharInfo, 256> table{};
+
+			for (auto& info : table)
+				info = { CharClass::CC_ILLEGAL, TokenType::TT_NONE };
+
+			table['\0'] = { CharClass::CC_END, TokenType::TT_EOF };
+			table[' '] = { CharClass::CC_WHITESPACE, TokenType::TT_NONE };
+			table['\t'] = { CharClass::CC_WHITESPACE, TokenType::TT_NONE };
+			table['\n'] = { CharClass::CC_WHITESPACE, TokenType::TT_NONE };
+			table['\r'] = { CharClass::CC_WHITESPACE, TokenType::TT_NONE };
+
+			for (char c = '0'; c <= '9'; c++)
+				table[c] = { CharClass::CC_DIGIT, TokenType::TT_NUMBER };
+
+			for (char c = 'a'; c <= 'z'; c++)
+				table[c] = { CharClass::CC_IDENTIFIER, TokenType::TT_IDENTIFIER };
+
+			for (char c = 'A'; c <= 'Z'; c++)
+				table[c] = { CharClass::CC_IDENTIFIER, TokenType::TT_IDENTIFIER };
+
+			table['_'] = { CharClass::CC_IDENTIFIER, TokenType::TT_IDENTIFIER };
+			table['\''] = { CharClass::CC_QUOTE, TokenType::TT_STRING };
+
+			// New operators only need a new entry here
+			table['+'] = { CharClass::CC_PUNCTUATOR, TokenType::TT_PLUS };
+			table['-'] = { CharClass::CC_PUNCTUATOR, TokenType::TT_MINUS };
+			table['*'] = { CharClass::CC_PUNCTUATOR, TokenType::TT_MULTIPLY };
+			table['/'] = { CharClass::CC_PUNCTUATOR, TokenType::TT_DIVIDE };
+			table['('] = { CharClass::CC_PUNCTUATOR, TokenType::TT_LPAREN };
+			table[')'] = { CharClass::CC_PUNCTUATOR, TokenType::TT_RPAREN };
+
+			return table;
+		}
+
+		inline constexpr std::array<CharInfo, 256> s_charTable = BuildCharTable();
+
+		constexpr const CharInfo& GetCharInfo(char c)
+		{
+			return s_charTable[static_cast<unsigned char>(c)];
+		}
+
+		/*********************/
+		/* Struct SourceSpan */
+		/*********************/
+		// Byte range of a token or node inside the script
+		struct SourceSpan {
+			uint32_t nOffset = 0;
+			uint32_t nLength = 0;
+
+			// Smallest span covering both spans
+			SourceSpan Cover(const SourceSpan& other) const;
+		};
+
+		/*************************/
+		/* Struct SourceLocation */
+		/*************************/
+		struct SourceLocation {
+			uint32_t nLine;
+			uint32_t nColumn;
+		};
+
+		/*******************/
+		/* Class LineIndex */
+		/*******************/
+		// Offsets of all line starts of a script. Only built when a location
+		// is actually needed, e.g. when printing an error.
+		class LineIndex {
+		public:
+			LineIndex();
+			LineIndex(std::string_view sScript);
+
+		public:
+			// Adds the next part of a script that is read in chunks
+			void Append(std::string_view sChunk);
+			// Line and column are 1-based, columns count bytes
+			SourceLocation GetLocation(uint32_t nOffset) const;
+
+		private:
+			std::vector<uint32_t> m_vLineStarts;
+			uint32_t m_nLength;
 		};
 
 		/***************/
 		/* Class Token */
 		/***************/
+		// Trivially copyable 16 byte token. The token refers to its text by
+		// its span in the script, the value of TT_NUMBER tokens and the
+		// interned id of TT_IDENTIFIER and TT_STRING tokens are stored
+		// inline so they stay valid without the script.
 		class Token {
 		public:
-			Token(TokenType type, TokenValue value);
+			Token(TokenType type, SourceSpan span, int32_t nValue = 0);
 			Token(TokenType type);
 			Token();
 
 			friend std::ostream& operator<<(std::ostream& os, const Token& token);
 
 		public:
-			TokenType GetTokenType();
-			void SetTokenType(TokenType value);
-			TokenValue GetValue();
-			void SetValue(TokenValue value);
+			TokenType GetTokenType() const;
+			SourceSpan GetSpan() const;
+			int32_t GetValue() const;
+			uint32_t GetInternId() const;
 
 		private:
 			TokenType m_type;
-			TokenValue m_value;
+			SourceSpan m_span;
+			int32_t m_nValue;
+		};
+
+		static_assert(std::is_trivially_copyable_v<Token>, "Token buffers are copied as plain memory");
+		static_assert(sizeof(Token) <= 16, "Token has to stay compact");
+
+		/******************/
+		/* Class ASTArena */
+		/******************/
+		// Bump allocator for AST nodes. Nodes are never destroyed one by one,
+		// the memory of all nodes is released together with the arena.
+		class ASTArena {
+		public:
+			ASTArena(size_t nBlockSize = 4096);
+			ASTArena(const ASTArena&) = delete;
+			ASTArena& operator=(const ASTArena&) = delete;
+			ASTArena(ASTArena&& other) noexcept;
+			ASTArena& operator=(ASTArena&& other) noexcept;
+
+		public:
+			template<typename T, typename... Args>
+			T* Create(Args&&... args)
+			{
+				static_assert(std::is_trivially_destructible_v<T>, "Arena nodes are released without running their destructor");
+				return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+			}
+
+			// Makes sure the next nBytes are served from a single block, blocks
+			// allocated after it are at least as large
+			void Reserve(size_t nBytes);
+			size_t GetBlockCount() const;
+
+		private:
+			void* Allocate(size_t nSize, size_t nAlign);
+
+		private:
+			std::vector<std::unique_ptr<char[]>> m_vBlocks;
+			char* m_pCurrent;
+			char* m_pEnd;
+			size_t m_nNextBlockSize;
 		};
 
 		/*****************/
 		/* Class ASTNode */
 		/*****************/
+		// Trees are walked with an explicit stack, so evaluating a deeply
+		// nested script is only limited by the heap
 		class ASTNode {
 		protected:
-			ASTNode() = default;
+			ASTNode(SourceSpan span);
+
+		public:
+			static constexpr size_t MAX_OPERANDS = 2;
 
 		public:
-			virtual int Interpret() = 0;
+			int Interpret() const;
+			// Appends the subtree in post-order and returns the index of this node
+			uint32_t Flatten(FlatAST& flat) const;
+			SourceSpan GetSpan() const;
+
+			// Fills ppOperands with the operands of this node and returns their count
+			virtual size_t GetOperands(const ASTNode** ppOperands) const = 0;
+			// Computes this node from the values of its operands
+			virtual int Evaluate(const int* pOperands) const = 0;
+			// Appends this node to flat, pOperands are the indices of its operands
+			virtual uint32_t AppendTo(FlatAST& flat, const uint32_t* pOperands) const = 0;
+			// Value of the node if it is known without evaluating anything
+			virtual std::optional<int> GetConstant() const;
+
+		private:
+			// Calls visit(pNode, nOperands) for every node in post-order
+			template<typename Visitor>
+			void Walk(Visitor visit) const;
+
+		private:
+			SourceSpan m_span;
 		};
 
 		/**********************/
@@ -178,14 +452,16 @@ namespace olc {
 		/**********************/
 		class ASTBinOpNode : public ASTNode {
 		public:
-			ASTBinOpNode(ASTNodeSharedPtr leftNode, Token op, ASTNodeSharedPtr rightNode);
+			ASTBinOpNode(ASTNode* leftNode, Token op, ASTNode* rightNode);
 
 		public:
-			int Interpret() override;
+			size_t GetOperands(const ASTNode** ppOperands) const override;
+			int Evaluate(const int* pOperands) const override;
+			uint32_t AppendTo(FlatAST& flat, const uint32_t* pOperands) const override;
 
 		private:
-			ASTNodeSharedPtr m_leftNode;
-			ASTNodeSharedPtr m_rightNode;
+			ASTNode* m_leftNode;
+			ASTNode* m_rightNode;
 			Token m_op;
 		};
 
@@ -194,13 +470,15 @@ namespace olc {
 		/************************/
 		class ASTUnaryOpNode : public ASTNode {
 		public:
-			ASTUnaryOpNode(Token op, ASTNodeSharedPtr node);
+			ASTUnaryOpNode(Token op, ASTNode* node);
 
 		public:
-			int Interpret() override;
+			size_t GetOperands(const ASTNode** ppOperands) const override;
+			int Evaluate(const int* pOperands) const override;
+			uint32_t AppendTo(FlatAST& flat, const uint32_t* pOperands) const override;
 
 		private:
-			ASTNodeSharedPtr m_node;
+			ASTNode* m_node;
 			Token m_op;
 		};
 
@@ -212,544 +490,3348 @@ namespace olc {
 			ASTNumNode(Token num);
 
 		public:
-			int Interpret() override;
+			size_t GetOperands(const ASTNode** ppOperands) const override;
+			int Evaluate(const int* pOperands) const override;
+			uint32_t AppendTo(FlatAST& flat, const uint32_t* pOperands) const override;
+			std::optional<int> GetConstant() const override;
 
 		private:
 			Token m_num;
 		};
 
-		/***************/
-		/* Class Error */
-		/***************/
-		class Error {
+		/*********************/
+		/* Enum FlatNodeKind */
+		/*********************/
+		enum class FlatNodeKind : uint8_t {
+			FNK_NUMBER,
+			FNK_PLUS,
+			FNK_NEGATE,
+			FNK_ADD,
+			FNK_SUBTRACT,
+			FNK_MULTIPLY,
+			FNK_DIVIDE
+		};
+
+		/*****************/
+		/* Class FlatAST */
+		/*****************/
+		// The AST as parallel arrays in post-order, the operands of a node
+		// always come before the node and the root is the last node. Unary
+		// nodes only use the left operand, numbers keep their value in the
+		// payload. Holds no pointers, so it can be copied as plain memory.
+		class FlatAST {
 		public:
-			Error(std::string sErrorName, std::string sErrorDescription);
+			FlatAST() = default;
 
 		public:
-			friend std::ostream& operator<<(std::ostream& os, const Error& error);
+			uint32_t AddNumber(int32_t nValue, SourceSpan span);
+			uint32_t AddUnary(FlatNodeKind kind, uint32_t nOperand, SourceSpan span);
+			uint32_t AddBinary(FlatNodeKind kind, uint32_t nLeft, uint32_t nRight, SourceSpan span);
+			void Reserve(size_t nNodes);
+
+			size_t GetSize() const;
+			FlatNodeKind GetKind(uint32_t nNode) const;
+			uint32_t GetLeft(uint32_t nNode) const;
+			uint32_t GetRight(uint32_t nNode) const;
+			int32_t GetValue(uint32_t nNode) const;
+			SourceSpan GetSpan(uint32_t nNode) const;
+
+			// Evaluates all nodes front to back, vResults is reused between calls
+			int Interpret(std::vector<int32_t>& vResults) const;
+			int Interpret() const;
 
-		protected:
-			std::string m_sErrorName;
-			std::string m_sErrorDescription;
+		private:
+			uint32_t AddNode(FlatNodeKind kind, uint32_t nLeft, uint32_t nRight, int32_t nValue, SourceSpan span);
+
+		private:
+			std::vector<FlatNodeKind> m_vKinds;
+			std::vector<uint32_t> m_vLefts;
+			std::vector<uint32_t> m_vRights;
+			std::vector<int32_t> m_vValues;
+			std::vector<SourceSpan> m_vSpans;
 		};
 
-		/**************************/
-		/* Class IllegalCharError */
-		/**************************/
-		class IllegalCharError : public Error {
+		/*************/
+		/* Class AST */
+		/*************/
+		// Result of a successful parse, owns the arena all nodes live in
+		class AST {
 		public:
-			IllegalCharError(std::string sErrorDescription);
-		};
+			AST(ASTArena&& arena, ASTNode* pRoot);
 
-		/******************************/
-		/* Class UnexpectedTokenError */
-		/******************************/
-		class UnexpectedTokenError : public Error {
 		public:
-			UnexpectedTokenError(std::vector<TokenType> expected, TokenType got);
+			ASTNode* GetRoot() const;
+			int Interpret() const;
+			FlatAST Flatten() const;
+
+		private:
+			ASTArena m_arena;
+			ASTNode* m_pRoot;
 		};
 
 		/***************/
-		/* Class Lexer */
+		/* Enum OpCode */
 		/***************/
-		class Lexer {
-		public:
-			Lexer(std::string sScript);
-
-		public:
-			LexerReturn GetNextToken();
-
-		private:
-			void Advance();
-			LexerReturn GenerateNumberToken();
+		enum class OpCode : uint8_t {
+			OP_PUSH,
+			OP_NEGATE,
+			OP_ADD,
+			OP_SUBTRACT,
+			OP_MULTIPLY,
+			OP_DIVIDE,
+			OP_RETURN
+		};
 
-		private:
-			char m_cCurrentChar;
-			std::istringstream m_isScript;
+		/**********************/
+		/* Struct Instruction */
+		/**********************/
+		// nOperand is the value of OP_PUSH and unused by all other opcodes
+		struct Instruction {
+			OpCode opCode;
+			int32_t nOperand;
 		};
 
-		/****************/
-		/* Class Parser */
-		/****************/
-		class Parser {
+		static_assert(sizeof(Instruction) <= 8, "Instructions have to stay compact");
+
+		/******************/
+		/* Class Bytecode */
+		/******************/
+		// Linear code for a stack machine. Every instruction pops its operands
+		// from the value stack and pushes its result, OP_RETURN pops the result
+		// of the script.
+		class Bytecode {
 		public:
-			Parser(Lexer& lexer);
+			// Compiles the post-order nodes directly into instructions
+			Bytecode(const FlatAST& flat);
+
 		public:
-			ParserReturn Parse();
+			// vStack is grown to GetMaxStackDepth and reused between calls
+			int Run(std::vector<int32_t>& vStack) const;
+			const std::vector<Instruction>& GetInstructions() const;
+			size_t GetMaxStackDepth() const;
 
 		private:
-			ParserReturn Expr();
-			ParserReturn Term();
-			ParserReturn Factor();
-			std::optional<Error> Eat(TokenType type);
+			void Emit(OpCode opCode, int32_t nOperand, int nStackEffect);
 
 		private:
-			Lexer& m_lexer;
-			Token m_currentToken;
+			std::vector<Instruction> m_vInstructions;
+			size_t m_nStackDepth;
+			size_t m_nMaxStackDepth;
 		};
-	}
-}
-#pragma endregion
-
-// O--------------------------------------------------------------------------O
-// | olcPGEX_Script IMPLEMENTATION                                            |
-// O--------------------------------------------------------------------------O
-#pragma region pgex_script_implementation
-
-#ifdef OLC_PGEX_SCRIPT
-#undef OLC_PGEX_SCRIPT
 
-namespace olc {
-	/****************/
-	/* Class Script */
-	/****************/
-
-	bool ScriptEngine::LoadScript(std::string sScript) {
-		script::Lexer lexer(sScript);
-		std::cout << "Loaded Script: " << sScript << std::endl;
-
-		script::Parser parser(lexer);
-		script::ParserReturn ret = parser.Parse();
-		if (std::holds_alternative<script::Error>(ret)) {
-			std::cout << "Error parsing script: " << std::get<script::Error>(ret) << std::endl;
-			return false;
-		}
-
-		script::ASTNodeSharedPtr node = std::get<script::ASTNodeSharedPtr>(ret);
-		int result = node->Interpret();
+		/***********************/
+		/* Enum RegisterOpCode */
+		/***********************/
+		enum class RegisterOpCode : uint8_t {
+			ROP_NEGATE,
+			ROP_ADD,
+			ROP_SUBTRACT,
+			ROP_MULTIPLY,
+			ROP_DIVIDE,
+			ROP_RETURN
+		};
 
-		std::cout << "Result: " << result << std::endl;
-		
-		return true;
-	}
+		/******************************/
+		/* Struct RegisterInstruction */
+		/******************************/
+		// Three-address instruction, nDest = nLeft op nRight. Unary operators
+		// and ROP_RETURN only read nLeft.
+		struct RegisterInstruction {
+			RegisterOpCode opCode;
+			uint32_t nDest;
+			uint32_t nLeft;
+			uint32_t nRight;
+		};
 
-	namespace script {
 		/**********************/
-		/* Class ASTBinOpNode */
+		/* Class RegisterCode */
 		/**********************/
-		ASTBinOpNode::ASTBinOpNode(ASTNodeSharedPtr leftNode, Token op, ASTNodeSharedPtr rightNode)
-			: m_leftNode(leftNode), m_op(op), m_rightNode(rightNode)
-		{ }
-
-		int ASTBinOpNode::Interpret()
-		{
-			switch (m_op.GetTokenType())
-			{
-			case TokenType::TT_PLUS:
-				return m_leftNode->Interpret() + m_rightNode->Interpret();
+		// Linear code for a register machine. The first registers hold the
+		// distinct literals of the script and are filled before the code runs,
+		// so literals cost no instruction. Temporaries are allocated above them
+		// like a stack, a value's register is freed once it is consumed.
+		class RegisterCode {
+		public:
+			RegisterCode(const FlatAST& flat);
 
-			case TokenType::TT_MINUS:
-				return m_leftNode->Interpret() - m_rightNode->Interpret();
+		public:
+			// vRegisters is grown to GetRegisterCount and reused between calls
+			int Run(std::vector<int32_t>& vRegisters) const;
+			const std::vector<RegisterInstruction>& GetInstructions() const;
+			size_t GetRegisterCount() const;
 
-			case TokenType::TT_MULTIPLY:
-				return m_leftNode->Interpret() * m_rightNode->Interpret();
+		private:
+			uint32_t GetConstantRegister(int32_t nValue, std::unordered_map<int32_t, uint32_t>& mapConstants);
+			uint32_t AllocateTemporary();
+			void FreeTemporary(uint32_t nRegister);
+			// Replaces the two topmost values by the result of opCode
+			void EmitBinary(RegisterOpCode opCode, std::vector<uint32_t>& vValues);
 
-			case TokenType::TT_DIVIDE:
-				return m_leftNode->Interpret() / m_rightNode->Interpret();
+		private:
+			std::vector<RegisterInstruction> m_vInstructions;
+			std::vector<int32_t> m_vConstants;
+			uint32_t m_nTemporaries;
+			uint32_t m_nMaxTemporaries;
+		};
 
-			default:
-				return 0;
-			}
-		}
+		/**********************/
+		/* Enum ExecutionTier */
+		/**********************/
+		enum class ExecutionTier {
+			ET_STACK_VM,
+			ET_REGISTER_VM
+		};
 
 		/************************/
-		/* Class ASTUnaryOpNode */
+		/* Class CompiledScript */
 		/************************/
-		ASTUnaryOpNode::ASTUnaryOpNode(Token op, ASTNodeSharedPtr node)
-			: m_node(node), m_op(op)
-		{ }
-
-		int ASTUnaryOpNode::Interpret()
-		{
-			switch (m_op.GetTokenType())
-			{
-			case TokenType::TT_PLUS:
-				return +m_node->Interpret();
+		// Immutable handle to a compiled script, copies share the same code.
+		// Running it needs no parsing, and no allocation once the scratch
+		// buffer has grown to the size of the script.
+		class CompiledScript {
+		public:
+			CompiledScript(const FlatAST& flat, ExecutionTier tier = ExecutionTier::ET_STACK_VM);
 
-			case TokenType::TT_MINUS:
-				return -m_node->Interpret();
+		public:
+			int Run(std::vector<int32_t>& vScratch) const;
+			ExecutionTier GetExecutionTier() const;
+			// Only the code of the tier the script was compiled for is set
+			const Bytecode* GetBytecode() const;
+			const RegisterCode* GetRegisterCode() const;
 
-			default:
-				return 0;
-			}
-		}
+		private:
+			std::shared_ptr<const Bytecode> m_pBytecode;
+			std::shared_ptr<const RegisterCode> m_pRegisterCode;
+		};
 
-		/********************/
-		/* Class ASTNumNode */
-		/********************/
-		ASTNumNode::ASTNumNode(Token numToken)
-			: m_num(numToken)
-		{ }
+		/******************/
+		/* Enum ErrorCode */
+		/******************/
+		enum class ErrorCode : uint8_t {
+			EC_NONE,
+			EC_ILLEGAL_CHAR,
+			EC_LEADING_ZERO,
+			EC_INTEGER_OVERFLOW,
+			EC_UNTERMINATED_STRING,
+			EC_UNEXPECTED_TOKEN,
+			EC_DIVISION_BY_ZERO,
+			EC_ARITHMETIC_OVERFLOW,
+			EC_NESTING_TOO_DEEP
+		};
 
-		int ASTNumNode::Interpret()
+		// Bit of a token type inside the expected mask of an Error
+		constexpr uint32_t GetTokenMask(TokenType type)
 		{
-			TokenValue num = m_num.GetValue();
-			if (std::holds_alternative<int32_t>(num))
-				return std::get<int32_t>(num);
-
-			// @TOOD: Fire error
-			return 0;
+			return 1u << uint32_t(type);
 		}
 
+		static_assert(uint32_t(TokenType::TT_STRING) < 32, "Every TokenType needs a bit in the expected mask");
 
 		/***************/
-		/* Class Token */
+		/* Class Error */
 		/***************/
-		Token::Token(TokenType type, TokenValue value) :
-			m_type(type), m_value(value)
-		{ }
-
-		Token::Token(TokenType type) :
-			m_type(type)
-		{ }
+		// Errors are small, trivially copyable values. The message is only
+		// formatted when the error is streamed, so failing is cheap.
+		class Error {
+		public:
+			Error(ErrorCode code, SourceSpan span, uint32_t nExpectedMask = 0, TokenType got = TokenType::TT_NONE, char cIllegal = '\0');
 
-		Token::Token() :
-			Token(TokenType::TT_NONE)
-		{ }
+		public:
+			friend std::ostream& operator<<(std::ostream& os, const Error& error);
+			// Same as operator<< but prefixed with the line and column of the error
+			void Print(std::ostream& os, const LineIndex& lineIndex) const;
+			ErrorCode GetCode() const;
+			SourceSpan GetSpan() const;
+			uint32_t GetExpectedMask() const;
+			TokenType GetGotTokenType() const;
 
-		TokenType Token::GetTokenType()
-		{
-			return m_type;
-		}
+		private:
+			const char* GetName() const;
+			void PrintDescription(std::ostream& os) const;
 
-		void Token::SetTokenType(TokenType value)
-		{
-			m_type = value;
-		}
+		protected:
+			ErrorCode m_code;
+			TokenType m_got;
+			char m_cIllegal;
+			SourceSpan m_span;
+			uint32_t m_nExpectedMask;
+		};
 
-		TokenValue Token::GetValue()
-		{
-			return m_value;
-		}
+		static_assert(std::is_trivially_copyable_v<Error>, "Errors have to stay cheap to pass around");
 
-		void Token::SetValue(TokenValue value)
-		{
-			m_value = value;
-		}
+		// The derived errors only provide constructors, they never add members
+		// so they can be returned as plain Error values
 
-		std::ostream& operator<< (std::ostream& os, const Token& token)
-		{
-			os << "Token(";
-			switch (token.m_type) {
-			case TokenType::TT_PLUS:
-				os << "PLUS";
-				break;
+		/**************************/
+		/* Class IllegalCharError */
+		/**************************/
+		class IllegalCharError : public Error {
+		public:
+			IllegalCharError(char cIllegal, SourceSpan span);
+		};
 
-			case TokenType::TT_MINUS:
-				os << "MINUS";
-				break;
+		/**************************/
+		/* Class LeadingZeroError */
+		/**************************/
+		class LeadingZeroError : public Error {
+		public:
+			LeadingZeroError(SourceSpan span);
+		};
 
-			case TokenType::TT_MULTIPLY:
-				os << "MULTIPLY";
-				break;
+		/******************************/
+		/* Class UnexpectedTokenError */
+		/******************************/
+		class UnexpectedTokenError : public Error {
+		public:
+			UnexpectedTokenError(std::initializer_list<TokenType> expected, const Token& got);
+		};
+
+		/******************************/
+		/* Class IntegerOverflowError */
+		/******************************/
+		class IntegerOverflowError : public Error {
+		public:
+			IntegerOverflowError(SourceSpan span);
+		};
+
+		/*********************************/
+		/* Class UnterminatedStringError */
+		/*********************************/
+		class UnterminatedStringError : public Error {
+		public:
+			UnterminatedStringError(SourceSpan span);
+		};
+
+		/*****************************/
+		/* Class NestingTooDeepError */
+		/*****************************/
+		class NestingTooDeepError : public Error {
+		public:
+			NestingTooDeepError(SourceSpan span);
+		};
+
+		/*****************************/
+		/* Class DivisionByZeroError */
+		/*****************************/
+		class DivisionByZeroError : public Error {
+		public:
+			DivisionByZeroError(SourceSpan span);
+		};
+
+		/*********************************/
+		/* Class ArithmeticOverflowError */
+		/*********************************/
+		class ArithmeticOverflowError : public Error {
+		public:
+			ArithmeticOverflowError(SourceSpan span);
+		};
+
+		/******************/
+		/* Class Expected */
+		/******************/
+		// Holds either a value or an Error. Unlike std::variant it can only
+		// be moved, so a result is never copied on its way out of the parser.
+		template<typename T>
+		class Expected {
+		public:
+			Expected(T value) : m_value(std::move(value)), m_bHasValue(true) { }
+			Expected(const Error& error) : m_error(error), m_bHasValue(false) { }
+			Expected(const Expected&) = delete;
+			Expected& operator=(const Expected&) = delete;
+
+			Expected(Expected&& other) noexcept : m_bHasValue(other.m_bHasValue)
+			{
+				if (m_bHasValue)
+					new (&m_value) T(std::move(other.m_value));
+				else
+					new (&m_error) Error(other.m_error);
+			}
+
+			Expected& operator=(Expected&& other) noexcept
+			{
+				if (this != &other) {
+					if (m_bHasValue)
+						m_value.~T();
+
+					m_bHasValue = other.m_bHasValue;
+					if (m_bHasValue)
+						new (&m_value) T(std::move(other.m_value));
+					else
+						new (&m_error) Error(other.m_error);
+				}
+
+				return *this;
+			}
+
+			~Expected()
+			{
+				if (m_bHasValue)
+					m_value.~T();
+			}
+
+		public:
+			bool HasValue() const { return m_bHasValue; }
+			T& GetValue() { return m_value; }
+			const T& GetValue() const { return m_value; }
+			const Error& GetError() const { return m_error; }
+
+		private:
+			union {
+				T m_value;
+				Error m_error;
+			};
+			bool m_bHasValue;
+		};
+
+		/*********************/
+		/* Class InternTable */
+		/*********************/
+		// Maps every distinct identifier or string to a dense id, so later
+		// stages compare integers instead of strings
+		class InternTable {
+		public:
+			InternTable() = default;
+			InternTable(const InternTable&) = delete;
+			InternTable& operator=(const InternTable&) = delete;
+			InternTable(InternTable&&) = default;
+			InternTable& operator=(InternTable&&) = default;
+
+		public:
+			uint32_t Intern(std::string_view sText);
+			std::string_view GetString(uint32_t nId) const;
+			size_t GetSize() const;
+
+		private:
+			// The keys point into m_dqStrings, a deque never moves its elements
+			std::unordered_map<std::string_view, uint32_t> m_mapIds;
+			std::deque<std::string> m_dqStrings;
+		};
+
+		/**********************/
+		/* Class SourceReader */
+		/**********************/
+		// Source of a script that is lexed while it is still being read
+		class SourceReader {
+		public:
+			virtual ~SourceReader() = default;
+
+		public:
+			// Copies up to nSize bytes into pBuffer and returns the number
+			// of bytes copied, 0 marks the end of the script
+			virtual size_t Read(char* pBuffer, size_t nSize) = 0;
+		};
+
+		/****************************/
+		/* Class StreamSourceReader */
+		/****************************/
+		// Reads from any stream buffer, e.g. an olc::ResourceBuffer:
+		//   olc::ResourceBuffer rb = pack.GetFileBuffer("scripts/mod.script");
+		//   olc::script::StreamSourceReader reader(rb);
+		class StreamSourceReader : public SourceReader {
+		public:
+			StreamSourceReader(std::streambuf& buffer);
+
+		public:
+			size_t Read(char* pBuffer, size_t nSize) override;
+
+		private:
+			std::streambuf& m_buffer;
+		};
+
+		/********************/
+		/* Class MappedFile */
+		/********************/
+		// Read-only view of a whole file. The file is memory mapped on Linux,
+		// macOS and Windows and read into memory on all other platforms.
+		class MappedFile {
+		public:
+			MappedFile(const std::string& sPath);
+			~MappedFile();
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+		public:
+			bool IsOpen() const;
+			std::string_view GetView() const;
+
+		private:
+			bool m_bOpen;
+			const char* m_pData;
+			size_t m_nSize;
+			void* m_hFile;
+			void* m_hMapping;
+			std::string m_sFallback;
+		};
+
+		/***************/
+		/* Class Lexer */
+		/***************/
+		// The lexer only borrows the script, the memory behind sScript
+		// has to outlive the lexer. Token offsets are 32-bit, so scripts
+		// are limited to 4 GiB. Identifiers and strings are interned into
+		// the given table, without one the lexer uses a table of its own.
+		// Token offsets start at nBaseOffset, so a piece of a larger script
+		// reports offsets into the whole script.
+		//
+		// A lexer created from a SourceReader pulls the script in chunks
+		// of nChunkSize bytes and only keeps the unfinished token and the
+		// current chunk in memory.
+		class Lexer {
+		public:
+			Lexer(std::string_view sScript);
+			Lexer(std::string_view sScript, InternTable& internTable, size_t nBaseOffset = 0);
+			Lexer(const char* pScript, size_t nLength);
+			Lexer(SourceReader& reader, InternTable& internTable, size_t nChunkSize = 64 * 1024);
+
+		public:
+			LexerReturn GetNextToken();
+			// Lexes the whole remaining script into one contiguous buffer,
+			// the last token in the buffer is always TT_EOF
+			TokenizerReturn Tokenize();
+			// Line starts of everything read so far, only filled when lexing
+			// from a SourceReader
+			const LineIndex& GetLineIndex() const;
+
+			// Splits the script at line breaks, which no token can span, and
+			// lexes the pieces on nThreads threads (0 uses all cores). Scripts
+			// below nMinPieceSize bytes per thread are lexed on fewer threads.
+			static TokenizerReturn TokenizeParallel(std::string_view sScript, InternTable& internTable,
+				size_t nThreads = 0, size_t nMinPieceSize = 256 * 1024);
+
+		private:
+			void Advance();
+			void SetPosition(size_t nPosition);
+			uint32_t GetOffset(size_t nPosition) const;
+			bool NeedsMoreInput() const;
+			void Refill(size_t nKeepFrom);
+			LexerReturn ScanToken();
+			LexerReturn GenerateNumberToken();
+			LexerReturn GenerateIdentifierToken();
+			LexerReturn GenerateStringToken();
+			InternTable& GetInternTable();
+
+		private:
+			char m_cCurrentChar;
+			size_t m_nPosition;
+			std::string_view m_sScript;
+			InternTable* m_pInternTable;
+			std::unique_ptr<InternTable> m_pOwnInternTable;
+			// Offset of m_sScript[0] in the whole script
+			size_t m_nWindowOffset;
+
+			// Only used when lexing from a SourceReader
+			SourceReader* m_pReader;
+			bool m_bReaderDone;
+			size_t m_nChunkSize;
+			std::vector<char> m_vWindow;
+			LineIndex m_lineIndex;
+		};
+
+		/***********************/
+		/* Struct OperatorInfo */
+		/***********************/
+		// Parser lookup entry of a token type, a precedence of 0 means the
+		// token can't be used as binary or as unary operator. Operators with
+		// a higher precedence bind tighter.
+		struct OperatorInfo {
+			uint8_t nBinaryPrecedence;
+			bool bRightAssociative;
+			uint8_t nUnaryPrecedence;
+		};
+
+		constexpr std::array<OperatorInfo, 32> BuildOperatorTable()
+		{
+			std::array<OperatorInfo, 32> table{};
+
+			for (auto& info : table)
+				info = { 0, false, 0 };
+
+			// A new operator also needs a case in GetBinaryNodeKind or
+			// GetUnaryNodeKind, which is checked below, and in these switches:
+			//   ASTBinOpNode::Evaluate or ASTUnaryOpNode::Evaluate
+			//   Parser::MakeBinaryNode or Parser::MakeUnaryNode
+			//   ConstantEvaluator::ApplyBinary or ConstantEvaluator::ApplyUnary
+			// A new FlatNodeKind needs a case in FlatAST::Interpret, Bytecode,
+			// RegisterCode and the opcodes of both VMs.
+			table[size_t(TokenType::TT_PLUS)] = { 1, false, 3 };
+			table[size_t(TokenType::TT_MINUS)] = { 1, false, 3 };
+			table[size_t(TokenType::TT_MULTIPLY)] = { 2, false, 0 };
+			table[size_t(TokenType::TT_DIVIDE)] = { 2, false, 0 };
+
+			return table;
+		}
+
+		inline constexpr std::array<OperatorInfo, 32> s_operatorTable = BuildOperatorTable();
+
+		constexpr const OperatorInfo& GetOperatorInfo(TokenType type)
+		{
+			return s_operatorTable[size_t(type)];
+		}
+
+		// Flat node of a binary operator, every binary operator of
+		// s_operatorTable needs a case here
+		constexpr std::optional<FlatNodeKind> GetBinaryNodeKind(TokenType type)
+		{
+			switch (type) {
+			case TokenType::TT_PLUS:
+				return FlatNodeKind::FNK_ADD;
+
+			case TokenType::TT_MINUS:
+				return FlatNodeKind::FNK_SUBTRACT;
+
+			case TokenType::TT_MULTIPLY:
+				return FlatNodeKind::FNK_MULTIPLY;
+
+			case TokenType::TT_DIVIDE:
+				return FlatNodeKind::FNK_DIVIDE;
+
+			default:
+				return std::nullopt;
+			}
+		}
+
+		// Flat node of a unary operator, every unary operator of
+		// s_operatorTable needs a case here
+		constexpr std::optional<FlatNodeKind> GetUnaryNodeKind(TokenType type)
+		{
+			switch (type) {
+			case TokenType::TT_PLUS:
+				return FlatNodeKind::FNK_PLUS;
+
+			case TokenType::TT_MINUS:
+				return FlatNodeKind::FNK_NEGATE;
+
+			default:
+				return std::nullopt;
+			}
+		}
+
+		constexpr bool HasNodeKinds()
+		{
+			for (size_t i = 0; i < s_operatorTable.size(); i++) {
+				if (s_operatorTable[i].nBinaryPrecedence > 0 && !GetBinaryNodeKind(TokenType(i)))
+					return false;
+
+				if (s_operatorTable[i].nUnaryPrecedence > 0 && !GetUnaryNodeKind(TokenType(i)))
+					return false;
+			}
+
+			return true;
+		}
+
+		static_assert(HasNodeKinds(), "Every operator of s_operatorTable needs a flat node kind");
+
+		/****************/
+		/* Class Parser */
+		/****************/
+		// Precedence climbing parser driven by s_operatorTable. Pending
+		// operators and parentheses live on an explicit stack instead of the
+		// call stack, its depth is limited by SetMaxDepth. Operators applied
+		// to constants are folded into a single ASTNumNode while parsing,
+		// results outside of 32-bit signed integers and divisions by zero
+		// are reported like EvaluateConstant does.
+		// The parser walks a token buffer produced by Lexer::Tokenize,
+		// the buffer has to outlive the parser
+		class Parser {
+		public:
+			Parser(const TokenBuffer& vTokens);
+		public:
+			ParserReturn Parse();
+			// Deeper nesting is reported as NestingTooDeepError
+			void SetMaxDepth(size_t nMaxDepth);
+			// Enabled by default
+			void SetConstantFolding(bool bEnabled);
+
+		private:
+			struct PendingOperator {
+				Token token;
+				// Binary operators binding at least this tight belong to the operand
+				uint8_t nMinPrecedence;
+				bool bUnary;
+			};
+
+		private:
+			NodeReturn Expression();
+			// Builds the node of the topmost pending operator
+			void Reduce();
+			ASTNode* MakeUnaryNode(const Token& op, ASTNode* node);
+			ASTNode* MakeBinaryNode(ASTNode* leftNode, const Token& op, ASTNode* rightNode);
+			// Keeps the first error, it is only reported once the script parsed
+			void FailArithmetic(const Error& error);
+			std::optional<Error> PushOperator(const Token& token, uint8_t nMinPrecedence, bool bUnary);
+			const Token& GetCurrentToken() const;
+			std::optional<Error> Eat(TokenType type);
+
+		private:
+			const TokenBuffer& m_vTokens;
+			size_t m_nCurrentToken;
+			size_t m_nMaxDepth;
+			bool m_bConstantFolding;
+			// First folded operation that doesn't fit into 32 bits or divides by zero
+			std::optional<Error> m_arithmeticError;
+			ASTArena m_arena;
+			std::vector<PendingOperator> m_vOperators;
+			std::vector<ASTNode*> m_vOperands;
+		};
+
+		/*************************/
+		/* Struct ConstantResult */
+		/*************************/
+		struct ConstantResult {
+			ErrorCode code = ErrorCode::EC_NONE;
+			SourceSpan span;
+			uint32_t nExpectedMask = 0;
+			TokenType got = TokenType::TT_NONE;
+			char cIllegal = '\0';
+			int32_t nValue = 0;
+
+			constexpr bool IsValid() const { return code == ErrorCode::EC_NONE; }
+			// Same error the runtime lexer and parser would report
+			Error GetError() const;
+		};
+
+		/***************************/
+		/* Class ConstantEvaluator */
+		/***************************/
+		// Lexes, parses and evaluates a script without any allocation, so
+		// literal scripts can be folded by the compiler:
+		//
+		//   constexpr auto speed = olc::script::EvaluateConstant("10 / 5 + 5 * 20");
+		//   static_assert(speed.IsValid(), "Invalid speed formula");
+		//
+		// Arithmetic is checked, division by zero and results outside of
+		// 32-bit signed integers are reported as errors. Like the runtime the
+		// whole script is lexed before parsing, so lexer errors come first, and
+		// arithmetic errors are only reported for scripts that parse.
+		//
+		// Nesting deeper than nMaxDepth is reported as NestingTooDeepError, at
+		// the same token the Parser would report it with that limit. Unlike the
+		// Parser the evaluator recurses, so the default stays far below the
+		// Parser's and larger limits need a large enough stack.
+		class ConstantEvaluator {
+		public:
+			static constexpr size_t DEFAULT_MAX_DEPTH = 1000;
+
+		public:
+			constexpr ConstantEvaluator(std::string_view sScript, size_t nMaxDepth = DEFAULT_MAX_DEPTH);
+
+		public:
+			constexpr ConstantResult Evaluate();
+
+		private:
+			struct ConstantToken {
+				TokenType type = TokenType::TT_NONE;
+				SourceSpan span;
+				int32_t nValue = 0;
+			};
+
+		private:
+			constexpr bool HasFailed() const;
+			constexpr int64_t Fail(ErrorCode code, SourceSpan span);
+			constexpr int64_t FailUnexpected(uint32_t nExpectedMask);
+			constexpr int64_t FailArithmetic(ErrorCode code, SourceSpan span);
+			constexpr int64_t Check(int64_t nValue, SourceSpan span);
+			constexpr void NextToken();
+			constexpr bool Eat(TokenType type);
+			// Eats an operator or parenthesis whose operand follows, callers
+			// decrement m_nDepth once the operand is done
+			constexpr bool PushOperator(const ConstantToken& token);
+			// Same precedence climbing as the Parser, on the call stack
+			constexpr int64_t Expression(uint8_t nMinPrecedence);
+			constexpr int64_t Operand();
+			constexpr int64_t ApplyUnary(const ConstantToken& op, int64_t nValue);
+			constexpr int64_t ApplyBinary(const ConstantToken& op, int64_t nLeft, int64_t nRight);
+
+		private:
+			std::string_view m_sScript;
+			size_t m_nPosition;
+			ConstantToken m_token;
+			ConstantResult m_result;
+			// Pending operators and parentheses, like the Parser's operator stack
+			size_t m_nDepth;
+			size_t m_nMaxDepth;
+			// First arithmetic error, kept until the whole script has parsed
+			ErrorCode m_arithmeticCode;
+			SourceSpan m_arithmeticSpan;
+		};
+
+		constexpr ConstantEvaluator::ConstantEvaluator(std::string_view sScript, size_t nMaxDepth) :
+			m_sScript(sScript), m_nPosition(0), m_token(), m_result(),
+			m_nDepth(0), m_nMaxDepth(nMaxDepth), m_arithmeticCode(ErrorCode::EC_NONE), m_arithmeticSpan()
+		{ }
+
+		constexpr ConstantResult ConstantEvaluator::Evaluate()
+		{
+			// Lexing pass, the runtime tokenizes the whole script before parsing
+			do {
+				NextToken();
+			} while (m_token.type != TokenType::TT_EOF);
+
+			if (HasFailed())
+				return m_result;
+
+			m_nPosition = 0;
+			NextToken();
+			int64_t nValue = Expression(0);
+
+			if (!HasFailed() && m_token.type != TokenType::TT_EOF)
+				FailUnexpected(GetTokenMask(TokenType::TT_EOF));
+
+			if (m_arithmeticCode != ErrorCode::EC_NONE)
+				Fail(m_arithmeticCode, m_arithmeticSpan);
+
+			if (!HasFailed())
+				m_result.nValue = int32_t(nValue);
+
+			return m_result;
+		}
+
+		constexpr bool ConstantEvaluator::HasFailed() const
+		{
+			return m_result.code != ErrorCode::EC_NONE;
+		}
+
+		constexpr int64_t ConstantEvaluator::Fail(ErrorCode code, SourceSpan span)
+		{
+			// Only the first error is reported
+			if (!HasFailed()) {
+				m_result.code = code;
+				m_result.span = span;
+			}
+
+			return 0;
+		}
+
+		constexpr int64_t ConstantEvaluator::FailUnexpected(uint32_t nExpectedMask)
+		{
+			if (!HasFailed()) {
+				m_result.nExpectedMask = nExpectedMask;
+				m_result.got = m_token.type;
+			}
+
+			return Fail(ErrorCode::EC_UNEXPECTED_TOKEN, m_token.span);
+		}
+
+		constexpr int64_t ConstantEvaluator::FailArithmetic(ErrorCode code, SourceSpan span)
+		{
+			// Like the runtime parser, parsing continues so syntax errors later
+			// in the script are reported first
+			if (m_arithmeticCode == ErrorCode::EC_NONE) {
+				m_arithmeticCode = code;
+				m_arithmeticSpan = span;
+			}
+
+			return 0;
+		}
+
+		constexpr int64_t ConstantEvaluator::Check(int64_t nValue, SourceSpan span)
+		{
+			if (nValue < INT32_MIN || nValue > INT32_MAX)
+				return FailArithmetic(ErrorCode::EC_ARITHMETIC_OVERFLOW, span);
+
+			return nValue;
+		}
+
+		constexpr void ConstantEvaluator::NextToken()
+		{
+			// Lexing stops at the first error, the token then stays TT_EOF
+			m_token = ConstantToken{ TokenType::TT_EOF, { uint32_t(m_nPosition), 0 }, 0 };
+			if (HasFailed())
+				return;
+
+			while (m_nPosition < m_sScript.size() && GetCharInfo(m_sScript[m_nPosition]).charClass == CharClass::CC_WHITESPACE)
+				m_nPosition++;
+
+			size_t nStart = m_nPosition;
+			char c = m_nPosition < m_sScript.size() ? m_sScript[m_nPosition] : '\0';
+			const CharInfo& info = GetCharInfo(c);
+			m_token.span.nOffset = uint32_t(nStart);
+
+			switch (info.charClass) {
+			case CharClass::CC_END:
+				return;
+
+			case CharClass::CC_PUNCTUATOR:
+				m_nPosition++;
+				m_token.type = info.tokenType;
+				m_token.span.nLength = 1;
+				return;
+
+			case CharClass::CC_DIGIT: {
+				if (c == '0') {
+					Fail(ErrorCode::EC_LEADING_ZERO, { uint32_t(nStart), 1 });
+					return;
+				}
+
+				int64_t nValue = 0;
+				bool bOverflow = false;
+				while (m_nPosition < m_sScript.size() && GetCharInfo(m_sScript[m_nPosition]).charClass == CharClass::CC_DIGIT) {
+					nValue = nValue * 10 + (m_sScript[m_nPosition] - '0');
+					bOverflow = bOverflow || nValue > INT32_MAX;
+					if (bOverflow)
+						nValue = INT32_MAX;
+
+					m_nPosition++;
+				}
+
+				SourceSpan span = { uint32_t(nStart), uint32_t(m_nPosition - nStart) };
+				if (bOverflow) {
+					Fail(ErrorCode::EC_INTEGER_OVERFLOW, span);
+					return;
+				}
+
+				if (m_nPosition < m_sScript.size() && GetCharInfo(m_sScript[m_nPosition]).charClass == CharClass::CC_IDENTIFIER) {
+					m_result.cIllegal = m_sScript[m_nPosition];
+					Fail(ErrorCode::EC_ILLEGAL_CHAR, { uint32_t(m_nPosition), 1 });
+					return;
+				}
+
+				m_token = ConstantToken{ TokenType::TT_NUMBER, span, int32_t(nValue) };
+				return;
+			}
+
+			case CharClass::CC_IDENTIFIER:
+				// Valid tokens, but constant scripts can't use them
+				while (m_nPosition < m_sScript.size()
+					&& (GetCharInfo(m_sScript[m_nPosition]).charClass == CharClass::CC_IDENTIFIER
+						|| GetCharInfo(m_sScript[m_nPosition]).charClass == CharClass::CC_DIGIT))
+					m_nPosition++;
+
+				m_token = ConstantToken{ TokenType::TT_IDENTIFIER, { uint32_t(nStart), uint32_t(m_nPosition - nStart) }, 0 };
+				return;
+
+			case CharClass::CC_QUOTE:
+				m_nPosition++;
+				while (m_nPosition < m_sScript.size() && m_sScript[m_nPosition] != '\'' && m_sScript[m_nPosition] != '\n')
+					m_nPosition++;
+
+				if (m_nPosition >= m_sScript.size() || m_sScript[m_nPosition] != '\'') {
+					Fail(ErrorCode::EC_UNTERMINATED_STRING, { uint32_t(nStart), uint32_t(m_nPosition - nStart) });
+					return;
+				}
+
+				m_nPosition++;
+				m_token = ConstantToken{ TokenType::TT_STRING, { uint32_t(nStart), uint32_t(m_nPosition - nStart) }, 0 };
+				return;
+
+			default:
+				m_result.cIllegal = c;
+				Fail(ErrorCode::EC_ILLEGAL_CHAR, { uint32_t(nStart), 1 });
+				return;
+			}
+		}
+
+		constexpr bool ConstantEvaluator::Eat(TokenType type)
+		{
+			if (m_token.type != type) {
+				FailUnexpected(GetTokenMask(type));
+				return false;
+			}
+
+			NextToken();
+			return !HasFailed();
+		}
+
+		constexpr bool ConstantEvaluator::PushOperator(const ConstantToken& token)
+		{
+			if (m_nDepth >= m_nMaxDepth) {
+				Fail(ErrorCode::EC_NESTING_TOO_DEEP, token.span);
+				return false;
+			}
+
+			if (!Eat(token.type))
+				return false;
+
+			m_nDepth++;
+			return true;
+		}
+
+		constexpr int64_t ConstantEvaluator::Expression(uint8_t nMinPrecedence)
+		{
+			int64_t nValue = Operand();
+
+			while (!HasFailed()) {
+				ConstantToken op = m_token;
+				const OperatorInfo& info = GetOperatorInfo(op.type);
+				if (info.nBinaryPrecedence == 0 || info.nBinaryPrecedence < nMinPrecedence)
+					break;
+
+				if (!PushOperator(op))
+					return 0;
+
+				// Left associative operators only take tighter binding operators
+				// into their right operand
+				int64_t nRight = Expression(info.bRightAssociative ? info.nBinaryPrecedence : info.nBinaryPrecedence + 1);
+				if (HasFailed())
+					return 0;
+
+				m_nDepth--;
+
+				nValue = ApplyBinary(op, nValue, nRight);
+			}
+
+			return nValue;
+		}
+
+		constexpr int64_t ConstantEvaluator::Operand()
+		{
+			ConstantToken token = m_token;
+
+			uint8_t nUnaryPrecedence = GetOperatorInfo(token.type).nUnaryPrecedence;
+			if (nUnaryPrecedence > 0) {
+				if (!PushOperator(token))
+					return 0;
+
+				int64_t nValue = Expression(nUnaryPrecedence);
+				if (HasFailed())
+					return 0;
+
+				m_nDepth--;
+				return ApplyUnary(token, nValue);
+			}
+
+			switch (token.type) {
+			case TokenType::TT_NUMBER:
+				Eat(token.type);
+				return token.nValue;
+
+			case TokenType::TT_LPAREN: {
+				// Parentheses start over at the lowest precedence
+				if (!PushOperator(token))
+					return 0;
+
+				int64_t nValue = Expression(0);
+				if (HasFailed() || !Eat(TokenType::TT_RPAREN))
+					return 0;
+
+				m_nDepth--;
+				return nValue;
+			}
+
+			default:
+				return FailUnexpected(GetTokenMask(TokenType::TT_LPAREN) | GetTokenMask(TokenType::TT_NUMBER));
+			}
+		}
+
+		constexpr int64_t ConstantEvaluator::ApplyUnary(const ConstantToken& op, int64_t nValue)
+		{
+			// Every unary operator of s_operatorTable needs a case here
+			switch (op.type) {
+			case TokenType::TT_PLUS:
+				return nValue;
+
+			case TokenType::TT_MINUS:
+				return Check(-nValue, op.span);
+
+			default:
+				assert(!"Every unary operator of s_operatorTable needs a case here");
+				return nValue;
+			}
+		}
+
+		constexpr int64_t ConstantEvaluator::ApplyBinary(const ConstantToken& op, int64_t nLeft, int64_t nRight)
+		{
+			// Every binary operator of s_operatorTable needs a case here
+			switch (op.type) {
+			case TokenType::TT_PLUS:
+				return Check(nLeft + nRight, op.span);
+
+			case TokenType::TT_MINUS:
+				return Check(nLeft - nRight, op.span);
+
+			case TokenType::TT_MULTIPLY:
+				return Check(nLeft * nRight, op.span);
+
+			case TokenType::TT_DIVIDE:
+				if (nRight == 0)
+					return FailArithmetic(ErrorCode::EC_DIVISION_BY_ZERO, op.span);
+
+				return Check(nLeft / nRight, op.span);
+
+			default:
+				assert(!"Every binary operator of s_operatorTable needs a case here");
+				return nLeft;
+			}
+		}
+
+		constexpr ConstantResult EvaluateConstant(std::string_view sScript, size_t nMaxDepth = ConstantEvaluator::DEFAULT_MAX_DEPTH)
+		{
+			return ConstantEvaluator(sScript, nMaxDepth).Evaluate();
+		}
+
+		/*********************/
+		/* Class ScriptCache */
+		/*********************/
+		// Compiled scripts keyed by the script source. Lookups hash the content,
+		// the least recently used script is evicted once the cache holds more
+		// than nCapacity scripts or more than nMaxBytes of source.
+		class ScriptCache {
+		public:
+			ScriptCache(size_t nCapacity = 256, size_t nMaxBytes = 16 * 1024 * 1024);
+			ScriptCache(const ScriptCache&) = delete;
+			ScriptCache& operator=(const ScriptCache&) = delete;
+
+		public:
+			// False if the cache is disabled or sScript is larger than nMaxBytes,
+			// such scripts are neither looked up nor copied
+			bool Accepts(std::string_view sScript) const;
+			// Returns nullptr if sScript wasn't compiled before
+			const CompilerReturn* Find(std::string_view sScript);
+			// Keeps a copy of sScript, which has to be accepted. The most recent
+			// script is always kept.
+			const CompilerReturn& Insert(std::string_view sScript, CompilerReturn&& result);
+			// A capacity of 0 disables the cache
+			void SetCapacity(size_t nCapacity);
+			void SetMaxBytes(size_t nMaxBytes);
+			size_t GetSize() const;
+			void Clear();
+
+		private:
+			struct Entry {
+				std::string sScript;
+				CompilerReturn result;
+			};
+
+		private:
+			void Evict();
+
+		private:
+			// Most recently used entries first, the keys point into Entry::sScript
+			std::list<Entry> m_lEntries;
+			std::unordered_map<std::string_view, std::list<Entry>::iterator> m_mapEntries;
+			size_t m_nCapacity;
+			size_t m_nMaxBytes;
+			// Source bytes of all entries
+			size_t m_nBytes;
+		};
+	}
+
+	/****************/
+	/* Class Script */
+	/****************/
+	class ScriptEngine : olc::PGEX {
+	public: 
+		ScriptEngine() = default;
+
+	public:
+		bool LoadScript(std::string_view sScript);
+		// Lexes the script while it is read, see script::StreamSourceReader
+		bool LoadScript(script::SourceReader& reader);
+		// Lexes the file directly from a read-only memory mapping
+		bool LoadScriptFile(const std::string& sPath);
+		// Identifiers and strings of all scripts loaded by this engine
+		const script::InternTable& GetInternTable() const;
+		// Number of scripts LoadScript and Compile keep compiled, 0 disables
+		// the cache, see script::ScriptCache
+		void SetCacheCapacity(size_t nCapacity);
+		// Source bytes the cache keeps, larger scripts are never copied
+		void SetCacheMaxBytes(size_t nMaxBytes);
+		// Deeper nesting is reported as NestingTooDeepError, see script::Parser
+		void SetMaxDepth(size_t nMaxDepth);
+
+		// Parses the script once into a handle that can be run any number of
+		// times. Errors are returned instead of printed.
+		script::CompilerReturn Compile(std::string_view sScript);
+		// Evaluates a compiled script without parsing, allocating or printing
+		int Run(const script::CompiledScript& script);
+		// Virtual machine scripts are compiled for, the stack VM by default
+		void SetExecutionTier(script::ExecutionTier tier);
+
+	private:
+		script::ParserReturn Parse(const script::TokenizerReturn& tokens);
+		script::CompilerReturn Generate(const script::ParserReturn& ast);
+		// Repeated sources skip lexing, parsing and code generation. Scripts the
+		// cache doesn't accept are compiled into uncached instead.
+		const script::CompilerReturn& CompileCached(std::string_view sScript, std::optional<script::CompilerReturn>& uncached);
+		std::optional<script::Error> Execute(const script::CompilerReturn& script);
+
+	private:
+		script::InternTable m_internTable;
+		script::ScriptCache m_scriptCache;
+		script::ExecutionTier m_executionTier = script::ExecutionTier::ET_STACK_VM;
+		size_t m_nMaxDepth = 1000000;
+		// Reused by every Run
+		std::vector<int32_t> m_vScratch;
+	};
+}
+#pragma endregion
+
+// O--------------------------------------------------------------------------O
+// | olcPGEX_Script IMPLEMENTATION                                            |
+// O--------------------------------------------------------------------------O
+#pragma region pgex_script_implementation
+
+#ifdef OLC_PGEX_SCRIPT
+#undef OLC_PGEX_SCRIPT
+
+namespace olc {
+	/****************/
+	/* Class Script */
+	/****************/
+
+	bool ScriptEngine::LoadScript(std::string_view sScript) {
+		std::cout << "Loaded Script: " << sScript << std::endl;
+
+		std::optional<script::CompilerReturn> uncached;
+		std::optional<script::Error> error = Execute(CompileCached(sScript, uncached));
+		if (error) {
+			std::cout << "Error parsing script: ";
+			error->Print(std::cout, script::LineIndex(sScript));
+			std::cout << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	bool ScriptEngine::LoadScript(script::SourceReader& reader) {
+		script::Lexer lexer(reader, m_internTable);
+		std::cout << "Loaded Script from reader" << std::endl;
+
+		std::optional<script::Error> error = Execute(Generate(Parse(lexer.Tokenize())));
+		if (error) {
+			std::cout << "Error parsing script: ";
+			error->Print(std::cout, lexer.GetLineIndex());
+			std::cout << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	bool ScriptEngine::LoadScriptFile(const std::string& sPath) {
+		script::MappedFile file(sPath);
+		if (!file.IsOpen()) {
+			std::cout << "Error loading script file: " << sPath << std::endl;
+			return false;
+		}
+
+		std::cout << "Loaded Script File: " << sPath << std::endl;
+
+		std::optional<script::Error> error = Execute(Generate(Parse(script::Lexer::TokenizeParallel(file.GetView(), m_internTable))));
+		if (error) {
+			std::cout << "Error parsing script: ";
+			error->Print(std::cout, script::LineIndex(file.GetView()));
+			std::cout << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	script::ParserReturn ScriptEngine::Parse(const script::TokenizerReturn& tokens)
+	{
+		if (std::holds_alternative<script::Error>(tokens))
+			return std::get<script::Error>(tokens);
+
+		script::Parser parser(std::get<script::TokenBuffer>(tokens));
+		parser.SetMaxDepth(m_nMaxDepth);
+		return parser.Parse();
+	}
+
+	script::CompilerReturn ScriptEngine::Generate(const script::ParserReturn& ast)
+	{
+		if (!ast.HasValue())
+			return ast.GetError();
+
+		return script::CompiledScript(ast.GetValue().Flatten(), m_executionTier);
+	}
+
+	const script::CompilerReturn& ScriptEngine::CompileCached(std::string_view sScript, std::optional<script::CompilerReturn>& uncached)
+	{
+		if (!m_scriptCache.Accepts(sScript))
+			return uncached.emplace(Generate(Parse(script::Lexer(sScript, m_internTable).Tokenize())));
+
+		const script::CompilerReturn* pScript = m_scriptCache.Find(sScript);
+		if (pScript != nullptr)
+			return *pScript;
+
+		return m_scriptCache.Insert(sScript, Generate(Parse(script::Lexer(sScript, m_internTable).Tokenize())));
+	}
+
+	std::optional<script::Error> ScriptEngine::Execute(const script::CompilerReturn& script)
+	{
+		if (!script.HasValue())
+			return script.GetError();
+
+		int result = Run(script.GetValue());
+
+		std::cout << "Result: " << result << std::endl;
+
+		return std::nullopt;
+	}
+
+	const script::InternTable& ScriptEngine::GetInternTable() const
+	{
+		return m_internTable;
+	}
+
+	void ScriptEngine::SetCacheCapacity(size_t nCapacity)
+	{
+		m_scriptCache.SetCapacity(nCapacity);
+	}
+
+	void ScriptEngine::SetCacheMaxBytes(size_t nMaxBytes)
+	{
+		m_scriptCache.SetMaxBytes(nMaxBytes);
+	}
+
+	void ScriptEngine::SetMaxDepth(size_t nMaxDepth)
+	{
+		// Cached scripts were parsed with the old limit
+		if (nMaxDepth != m_nMaxDepth)
+			m_scriptCache.Clear();
+
+		m_nMaxDepth = nMaxDepth;
+	}
+
+	script::CompilerReturn ScriptEngine::Compile(std::string_view sScript)
+	{
+		std::optional<script::CompilerReturn> uncached;
+		const script::CompilerReturn& script = CompileCached(sScript, uncached);
+		if (!script.HasValue())
+			return script.GetError();
+
+		return script.GetValue();
+	}
+
+	int ScriptEngine::Run(const script::CompiledScript& script)
+	{
+		return script.Run(m_vScratch);
+	}
+
+	void ScriptEngine::SetExecutionTier(script::ExecutionTier tier)
+	{
+		// Cached scripts were compiled for the previous tier
+		if (tier != m_executionTier)
+			m_scriptCache.Clear();
+
+		m_executionTier = tier;
+	}
+
+	namespace script {
+		/******************/
+		/* Class ASTArena */
+		/******************/
+		ASTArena::ASTArena(size_t nBlockSize)
+			: m_pCurrent(nullptr), m_pEnd(nullptr), m_nNextBlockSize(nBlockSize)
+		{ }
+
+		ASTArena::ASTArena(ASTArena&& other) noexcept
+			: m_vBlocks(std::move(other.m_vBlocks)),
+			m_pCurrent(std::exchange(other.m_pCurrent, nullptr)),
+			m_pEnd(std::exchange(other.m_pEnd, nullptr)),
+			m_nNextBlockSize(other.m_nNextBlockSize)
+		{
+			other.m_vBlocks.clear();
+		}
+
+		ASTArena& ASTArena::operator=(ASTArena&& other) noexcept
+		{
+			m_vBlocks = std::move(other.m_vBlocks);
+			other.m_vBlocks.clear();
+			m_pCurrent = std::exchange(other.m_pCurrent, nullptr);
+			m_pEnd = std::exchange(other.m_pEnd, nullptr);
+			m_nNextBlockSize = other.m_nNextBlockSize;
+			return *this;
+		}
+
+		void ASTArena::Reserve(size_t nBytes)
+		{
+			if (size_t(m_pEnd - m_pCurrent) >= nBytes)
+				return;
+
+			// Not value initialized, every node is constructed before it is read
+			m_vBlocks.emplace_back(new char[nBytes]);
+			m_pCurrent = m_vBlocks.back().get();
+			m_pEnd = m_pCurrent + nBytes;
+			m_nNextBlockSize = std::max(m_nNextBlockSize, nBytes);
+		}
+
+		size_t ASTArena::GetBlockCount() const
+		{
+			return m_vBlocks.size();
+		}
+
+		void* ASTArena::Allocate(size_t nSize, size_t nAlign)
+		{
+			size_t nPadding = (nAlign - uintptr_t(m_pCurrent) % nAlign) % nAlign;
+			if (m_pCurrent == nullptr || size_t(m_pEnd - m_pCurrent) < nPadding + nSize) {
+				// Blocks double in size, a large script needs only a few of them
+				Reserve(std::max(m_nNextBlockSize, nSize + nAlign));
+				m_nNextBlockSize *= 2;
+				nPadding = (nAlign - uintptr_t(m_pCurrent) % nAlign) % nAlign;
+			}
+
+			void* pMemory = m_pCurrent + nPadding;
+			m_pCurrent += nPadding + nSize;
+			return pMemory;
+		}
+
+		/*****************/
+		/* Class ASTNode */
+		/*****************/
+		ASTNode::ASTNode(SourceSpan span)
+			: m_span(span)
+		{ }
+
+		SourceSpan ASTNode::GetSpan() const
+		{
+			return m_span;
+		}
+
+		std::optional<int> ASTNode::GetConstant() const
+		{
+			return std::nullopt;
+		}
+
+		template<typename Visitor>
+		void ASTNode::Walk(Visitor visit) const
+		{
+			struct Frame {
+				const ASTNode* pNode;
+				const ASTNode* operands[MAX_OPERANDS];
+				size_t nOperands;
+				size_t nNextOperand;
+			};
+
+			std::vector<Frame> vStack;
+			auto Push = [&](const ASTNode* pNode) {
+				Frame frame = { pNode, {}, 0, 0 };
+				frame.nOperands = pNode->GetOperands(frame.operands);
+				vStack.push_back(frame);
+			};
+
+			Push(this);
+			while (!vStack.empty()) {
+				Frame& frame = vStack.back();
+				if (frame.nNextOperand < frame.nOperands) {
+					Push(frame.operands[frame.nNextOperand++]);
+					continue;
+				}
+
+				const ASTNode* pNode = frame.pNode;
+				size_t nOperands = frame.nOperands;
+				vStack.pop_back();
+				visit(pNode, nOperands);
+			}
+		}
+
+		int ASTNode::Interpret() const
+		{
+			std::vector<int> vValues;
+
+			Walk([&](const ASTNode* pNode, size_t nOperands) {
+				int nResult = pNode->Evaluate(vValues.data() + vValues.size() - nOperands);
+				vValues.resize(vValues.size() - nOperands);
+				vValues.push_back(nResult);
+			});
+
+			return vValues.back();
+		}
+
+		uint32_t ASTNode::Flatten(FlatAST& flat) const
+		{
+			std::vector<uint32_t> vIndices;
+
+			Walk([&](const ASTNode* pNode, size_t nOperands) {
+				uint32_t nIndex = pNode->AppendTo(flat, vIndices.data() + vIndices.size() - nOperands);
+				vIndices.resize(vIndices.size() - nOperands);
+				vIndices.push_back(nIndex);
+			});
+
+			return vIndices.back();
+		}
+
+		/**********************/
+		/* Class ASTBinOpNode */
+		/**********************/
+		ASTBinOpNode::ASTBinOpNode(ASTNode* leftNode, Token op, ASTNode* rightNode)
+			: ASTNode(leftNode->GetSpan().Cover(rightNode->GetSpan())), m_leftNode(leftNode), m_op(op), m_rightNode(rightNode)
+		{ }
+
+		size_t ASTBinOpNode::GetOperands(const ASTNode** ppOperands) const
+		{
+			ppOperands[0] = m_leftNode;
+			ppOperands[1] = m_rightNode;
+			return 2;
+		}
+
+		uint32_t ASTBinOpNode::AppendTo(FlatAST& flat, const uint32_t* pOperands) const
+		{
+			uint32_t nLeft = pOperands[0];
+			uint32_t nRight = pOperands[1];
+
+			// The parser only creates nodes for operators of s_operatorTable,
+			// which all have a node kind
+			return flat.AddBinary(*GetBinaryNodeKind(m_op.GetTokenType()), nLeft, nRight, GetSpan());
+		}
+
+		int ASTBinOpNode::Evaluate(const int* pOperands) const
+		{
+			switch (m_op.GetTokenType())
+			{
+			case TokenType::TT_PLUS:
+				return pOperands[0] + pOperands[1];
+
+			case TokenType::TT_MINUS:
+				return pOperands[0] - pOperands[1];
+
+			case TokenType::TT_MULTIPLY:
+				return pOperands[0] * pOperands[1];
+
+			case TokenType::TT_DIVIDE:
+				return pOperands[0] / pOperands[1];
+
+			default:
+				assert(!"Every binary operator of s_operatorTable needs a case here");
+				return 0;
+			}
+		}
+
+		/************************/
+		/* Class ASTUnaryOpNode */
+		/************************/
+		ASTUnaryOpNode::ASTUnaryOpNode(Token op, ASTNode* node)
+			: ASTNode(op.GetSpan().Cover(node->GetSpan())), m_node(node), m_op(op)
+		{ }
+
+		size_t ASTUnaryOpNode::GetOperands(const ASTNode** ppOperands) const
+		{
+			ppOperands[0] = m_node;
+			return 1;
+		}
+
+		uint32_t ASTUnaryOpNode::AppendTo(FlatAST& flat, const uint32_t* pOperands) const
+		{
+			return flat.AddUnary(*GetUnaryNodeKind(m_op.GetTokenType()), pOperands[0], GetSpan());
+		}
+
+		int ASTUnaryOpNode::Evaluate(const int* pOperands) const
+		{
+			switch (m_op.GetTokenType())
+			{
+			case TokenType::TT_PLUS:
+				return +pOperands[0];
+
+			case TokenType::TT_MINUS:
+				return -pOperands[0];
+
+			default:
+				assert(!"Every unary operator of s_operatorTable needs a case here");
+				return 0;
+			}
+		}
+
+		/********************/
+		/* Class ASTNumNode */
+		/********************/
+		ASTNumNode::ASTNumNode(Token numToken)
+			: ASTNode(numToken.GetSpan()), m_num(numToken)
+		{ }
+
+		size_t ASTNumNode::GetOperands(const ASTNode**) const
+		{
+			return 0;
+		}
+
+		int ASTNumNode::Evaluate(const int*) const
+		{
+			return m_num.GetValue();
+		}
+
+		uint32_t ASTNumNode::AppendTo(FlatAST& flat, const uint32_t*) const
+		{
+			return flat.AddNumber(m_num.GetValue(), GetSpan());
+		}
+
+		std::optional<int> ASTNumNode::GetConstant() const
+		{
+			return m_num.GetValue();
+		}
+
+		/*****************/
+		/* Class FlatAST */
+		/*****************/
+		uint32_t FlatAST::AddNode(FlatNodeKind kind, uint32_t nLeft, uint32_t nRight, int32_t nValue, SourceSpan span)
+		{
+			m_vKinds.push_back(kind);
+			m_vLefts.push_back(nLeft);
+			m_vRights.push_back(nRight);
+			m_vValues.push_back(nValue);
+			m_vSpans.push_back(span);
+			return uint32_t(m_vKinds.size() - 1);
+		}
+
+		uint32_t FlatAST::AddNumber(int32_t nValue, SourceSpan span)
+		{
+			return AddNode(FlatNodeKind::FNK_NUMBER, 0, 0, nValue, span);
+		}
+
+		uint32_t FlatAST::AddUnary(FlatNodeKind kind, uint32_t nOperand, SourceSpan span)
+		{
+			return AddNode(kind, nOperand, 0, 0, span);
+		}
+
+		uint32_t FlatAST::AddBinary(FlatNodeKind kind, uint32_t nLeft, uint32_t nRight, SourceSpan span)
+		{
+			return AddNode(kind, nLeft, nRight, 0, span);
+		}
+
+		void FlatAST::Reserve(size_t nNodes)
+		{
+			m_vKinds.reserve(nNodes);
+			m_vLefts.reserve(nNodes);
+			m_vRights.reserve(nNodes);
+			m_vValues.reserve(nNodes);
+			m_vSpans.reserve(nNodes);
+		}
+
+		size_t FlatAST::GetSize() const
+		{
+			return m_vKinds.size();
+		}
+
+		FlatNodeKind FlatAST::GetKind(uint32_t nNode) const
+		{
+			return m_vKinds[nNode];
+		}
+
+		uint32_t FlatAST::GetLeft(uint32_t nNode) const
+		{
+			return m_vLefts[nNode];
+		}
+
+		uint32_t FlatAST::GetRight(uint32_t nNode) const
+		{
+			return m_vRights[nNode];
+		}
+
+		int32_t FlatAST::GetValue(uint32_t nNode) const
+		{
+			return m_vValues[nNode];
+		}
+
+		SourceSpan FlatAST::GetSpan(uint32_t nNode) const
+		{
+			return m_vSpans[nNode];
+		}
+
+		int FlatAST::Interpret(std::vector<int32_t>& vResults) const
+		{
+			if (m_vKinds.empty())
+				return 0;
+
+			vResults.resize(m_vKinds.size());
+
+			// Post-order guarantees the operands are already evaluated
+			for (size_t i = 0; i < m_vKinds.size(); i++) {
+				switch (m_vKinds[i])
+				{
+				case FlatNodeKind::FNK_NUMBER:
+					vResults[i] = m_vValues[i];
+					break;
+
+				case FlatNodeKind::FNK_PLUS:
+					vResults[i] = vResults[m_vLefts[i]];
+					break;
+
+				case FlatNodeKind::FNK_NEGATE:
+					vResults[i] = -vResults[m_vLefts[i]];
+					break;
+
+				case FlatNodeKind::FNK_ADD:
+					vResults[i] = vResults[m_vLefts[i]] + vResults[m_vRights[i]];
+					break;
+
+				case FlatNodeKind::FNK_SUBTRACT:
+					vResults[i] = vResults[m_vLefts[i]] - vResults[m_vRights[i]];
+					break;
+
+				case FlatNodeKind::FNK_MULTIPLY:
+					vResults[i] = vResults[m_vLefts[i]] * vResults[m_vRights[i]];
+					break;
+
+				case FlatNodeKind::FNK_DIVIDE:
+					vResults[i] = vResults[m_vLefts[i]] / vResults[m_vRights[i]];
+					break;
+				}
+			}
+
+			return vResults.back();
+		}
+
+		int FlatAST::Interpret() const
+		{
+			std::vector<int32_t> vResults;
+			return Interpret(vResults);
+		}
+
+		/*************/
+		/* Class AST */
+		/*************/
+		AST::AST(ASTArena&& arena, ASTNode* pRoot)
+			: m_arena(std::move(arena)), m_pRoot(pRoot)
+		{ }
+
+		ASTNode* AST::GetRoot() const
+		{
+			return m_pRoot;
+		}
+
+		int AST::Interpret() const
+		{
+			return m_pRoot->Interpret();
+		}
+
+		FlatAST AST::Flatten() const
+		{
+			FlatAST flat;
+			m_pRoot->Flatten(flat);
+			return flat;
+		}
+
+		/******************/
+		/* Class Bytecode */
+		/******************/
+		Bytecode::Bytecode(const FlatAST& flat)
+			: m_nStackDepth(0), m_nMaxStackDepth(0)
+		{
+			m_vInstructions.reserve(flat.GetSize() + 1);
+
+			for (uint32_t i = 0; i < flat.GetSize(); i++) {
+				switch (flat.GetKind(i))
+				{
+				case FlatNodeKind::FNK_NUMBER:
+					Emit(OpCode::OP_PUSH, flat.GetValue(i), 1);
+					break;
+
+				case FlatNodeKind::FNK_PLUS:
+					// The operand already is the result
+					break;
+
+				case FlatNodeKind::FNK_NEGATE:
+					Emit(OpCode::OP_NEGATE, 0, 0);
+					break;
+
+				case FlatNodeKind::FNK_ADD:
+					Emit(OpCode::OP_ADD, 0, -1);
+					break;
+
+				case FlatNodeKind::FNK_SUBTRACT:
+					Emit(OpCode::OP_SUBTRACT, 0, -1);
+					break;
+
+				case FlatNodeKind::FNK_MULTIPLY:
+					Emit(OpCode::OP_MULTIPLY, 0, -1);
+					break;
+
+				case FlatNodeKind::FNK_DIVIDE:
+					Emit(OpCode::OP_DIVIDE, 0, -1);
+					break;
+				}
+			}
+
+			// An empty script returns 0 like FlatAST::Interpret
+			if (m_vInstructions.empty())
+				Emit(OpCode::OP_PUSH, 0, 1);
+
+			Emit(OpCode::OP_RETURN, 0, -1);
+		}
+
+		void Bytecode::Emit(OpCode opCode, int32_t nOperand, int nStackEffect)
+		{
+			m_vInstructions.push_back({ opCode, nOperand });
+			m_nStackDepth += nStackEffect;
+			m_nMaxStackDepth = std::max(m_nMaxStackDepth, m_nStackDepth);
+		}
+
+		// Both VMs write their handlers once with these macros. With computed
+		// goto every handler ends in its own indirect jump through
+		// s_pDispatch, indexed by the opcode, so the branch predictor learns
+		// each opcode's successors separately and there is no bounds check.
+		// The table has to list the labels in the order of the opcode enum.
+#if defined(OLC_SCRIPT_COMPUTED_GOTO)
+	#define OLC_SCRIPT_VM_START() goto *s_pDispatch[size_t(pInstruction->opCode)];
+	#define OLC_SCRIPT_VM_CASE(enumType, opCode) opCode:
+	#define OLC_SCRIPT_VM_NEXT() goto *s_pDispatch[size_t((++pInstruction)->opCode)]
+	#define OLC_SCRIPT_VM_END()
+#else
+	#define OLC_SCRIPT_VM_START() while (true) { switch (pInstruction->opCode) {
+	#define OLC_SCRIPT_VM_CASE(enumType, opCode) case enumType::opCode:
+	#define OLC_SCRIPT_VM_NEXT() pInstruction++; continue
+	#define OLC_SCRIPT_VM_END() } }
+#endif
+
+		int Bytecode::Run(std::vector<int32_t>& vStack) const
+		{
+#if defined(OLC_SCRIPT_COMPUTED_GOTO)
+			static const void* const s_pDispatch[] = {
+				&&OP_PUSH, &&OP_NEGATE, &&OP_ADD, &&OP_SUBTRACT, &&OP_MULTIPLY, &&OP_DIVIDE, &&OP_RETURN
+			};
+#endif
+
+			if (vStack.size() < m_nMaxStackDepth)
+				vStack.resize(m_nMaxStackDepth);
+
+			const Instruction* pInstruction = m_vInstructions.data();
+			// Points behind the topmost value
+			int32_t* pTop = vStack.data();
+
+			OLC_SCRIPT_VM_START()
+
+			OLC_SCRIPT_VM_CASE(OpCode, OP_PUSH)
+				*pTop++ = pInstruction->nOperand;
+				OLC_SCRIPT_VM_NEXT();
+
+			OLC_SCRIPT_VM_CASE(OpCode, OP_NEGATE)
+				pTop[-1] = -pTop[-1];
+				OLC_SCRIPT_VM_NEXT();
+
+			OLC_SCRIPT_VM_CASE(OpCode, OP_ADD)
+				pTop--;
+				pTop[-1] = pTop[-1] + pTop[0];
+				OLC_SCRIPT_VM_NEXT();
+
+			OLC_SCRIPT_VM_CASE(OpCode, OP_SUBTRACT)
+				pTop--;
+				pTop[-1] = pTop[-1] - pTop[0];
+				OLC_SCRIPT_VM_NEXT();
+
+			OLC_SCRIPT_VM_CASE(OpCode, OP_MULTIPLY)
+				pTop--;
+				pTop[-1] = pTop[-1] * pTop[0];
+				OLC_SCRIPT_VM_NEXT();
+
+			OLC_SCRIPT_VM_CASE(OpCode, OP_DIVIDE)
+				pTop--;
+				pTop[-1] = pTop[-1] / pTop[0];
+				OLC_SCRIPT_VM_NEXT();
+
+			OLC_SCRIPT_VM_CASE(OpCode, OP_RETURN)
+				return pTop[-1];
+
+			OLC_SCRIPT_VM_END()
+		}
+
+		const std::vector<Instruction>& Bytecode::GetInstructions() const
+		{
+			return m_vInstructions;
+		}
+
+		size_t Bytecode::GetMaxStackDepth() const
+		{
+			return m_nMaxStackDepth;
+		}
+
+		/**********************/
+		/* Class RegisterCode */
+		/**********************/
+		RegisterCode::RegisterCode(const FlatAST& flat)
+			: m_nTemporaries(0), m_nMaxTemporaries(0)
+		{
+			std::unordered_map<int32_t, uint32_t> mapConstants;
+			// Registers of the values not consumed yet
+			std::vector<uint32_t> vValues;
+
+			// Literals are numbered first, temporaries start behind them
+			for (uint32_t i = 0; i < flat.GetSize(); i++) {
+				if (flat.GetKind(i) == FlatNodeKind::FNK_NUMBER)
+					GetConstantRegister(flat.GetValue(i), mapConstants);
+			}
+
+			if (flat.GetSize() == 0)
+				GetConstantRegister(0, mapConstants);
+
+			for (uint32_t i = 0; i < flat.GetSize(); i++) {
+				switch (flat.GetKind(i))
+				{
+				case FlatNodeKind::FNK_NUMBER:
+					vValues.push_back(GetConstantRegister(flat.GetValue(i), mapConstants));
+					break;
+
+				case FlatNodeKind::FNK_PLUS:
+					// The operand already is the result
+					break;
+
+				case FlatNodeKind::FNK_NEGATE: {
+					uint32_t nOperand = vValues.back();
+					FreeTemporary(nOperand);
+					vValues.back() = AllocateTemporary();
+					m_vInstructions.push_back({ RegisterOpCode::ROP_NEGATE, vValues.back(), nOperand, 0 });
+					break;
+				}
+
+				case FlatNodeKind::FNK_ADD:
+					EmitBinary(RegisterOpCode::ROP_ADD, vValues);
+					break;
+
+				case FlatNodeKind::FNK_SUBTRACT:
+					EmitBinary(RegisterOpCode::ROP_SUBTRACT, vValues);
+					break;
+
+				case FlatNodeKind::FNK_MULTIPLY:
+					EmitBinary(RegisterOpCode::ROP_MULTIPLY, vValues);
+					break;
+
+				case FlatNodeKind::FNK_DIVIDE:
+					EmitBinary(RegisterOpCode::ROP_DIVIDE, vValues);
+					break;
+				}
+			}
+
+			uint32_t nResult = vValues.empty() ? 0 : vValues.back();
+			m_vInstructions.push_back({ RegisterOpCode::ROP_RETURN, 0, nResult, 0 });
+		}
+
+		uint32_t RegisterCode::GetConstantRegister(int32_t nValue, std::unordered_map<int32_t, uint32_t>& mapConstants)
+		{
+			auto it = mapConstants.find(nValue);
+			if (it != mapConstants.end())
+				return it->second;
+
+			m_vConstants.push_back(nValue);
+			mapConstants.emplace(nValue, uint32_t(m_vConstants.size() - 1));
+			return uint32_t(m_vConstants.size() - 1);
+		}
+
+		uint32_t RegisterCode::AllocateTemporary()
+		{
+			m_nMaxTemporaries = std::max(m_nMaxTemporaries, m_nTemporaries + 1);
+			return uint32_t(m_vConstants.size()) + m_nTemporaries++;
+		}
+
+		void RegisterCode::FreeTemporary(uint32_t nRegister)
+		{
+			if (nRegister >= m_vConstants.size())
+				m_nTemporaries--;
+		}
+
+		void RegisterCode::EmitBinary(RegisterOpCode opCode, std::vector<uint32_t>& vValues)
+		{
+			uint32_t nRight = vValues.back();
+			vValues.pop_back();
+			uint32_t nLeft = vValues.back();
+
+			// The right operand was allocated last, so it is freed first
+			FreeTemporary(nRight);
+			FreeTemporary(nLeft);
+			vValues.back() = AllocateTemporary();
+
+			m_vInstructions.push_back({ opCode, vValues.back(), nLeft, nRight });
+		}
+
+		int RegisterCode::Run(std::vector<int32_t>& vRegisters) const
+		{
+#if defined(OLC_SCRIPT_COMPUTED_GOTO)
+			static const void* const s_pDispatch[] = {
+				&&ROP_NEGATE, &&ROP_ADD, &&ROP_SUBTRACT, &&ROP_MULTIPLY, &&ROP_DIVIDE, &&ROP_RETURN
+			};
+#endif
+
+			if (vRegisters.size() < GetRegisterCount())
+				vRegisters.resize(GetRegisterCount());
+
+			int32_t* pRegisters = vRegisters.data();
+			std::copy(m_vConstants.begin(), m_vConstants.end(), pRegisters);
+
+			const RegisterInstruction* pInstruction = m_vInstructions.data();
+
+			OLC_SCRIPT_VM_START()
+
+			OLC_SCRIPT_VM_CASE(RegisterOpCode, ROP_NEGATE)
+				pRegisters[pInstruction->nDest] = -pRegisters[pInstruction->nLeft];
+				OLC_SCRIPT_VM_NEXT();
+
+			OLC_SCRIPT_VM_CASE(RegisterOpCode, ROP_ADD)
+				pRegisters[pInstruction->nDest] = pRegisters[pInstruction->nLeft] + pRegisters[pInstruction->nRight];
+				OLC_SCRIPT_VM_NEXT();
+
+			OLC_SCRIPT_VM_CASE(RegisterOpCode, ROP_SUBTRACT)
+				pRegisters[pInstruction->nDest] = pRegisters[pInstruction->nLeft] - pRegisters[pInstruction->nRight];
+				OLC_SCRIPT_VM_NEXT();
+
+			OLC_SCRIPT_VM_CASE(RegisterOpCode, ROP_MULTIPLY)
+				pRegisters[pInstruction->nDest] = pRegisters[pInstruction->nLeft] * pRegisters[pInstruction->nRight];
+				OLC_SCRIPT_VM_NEXT();
+
+			OLC_SCRIPT_VM_CASE(RegisterOpCode, ROP_DIVIDE)
+				pRegisters[pInstruction->nDest] = pRegisters[pInstruction->nLeft] / pRegisters[pInstruction->nRight];
+				OLC_SCRIPT_VM_NEXT();
+
+			OLC_SCRIPT_VM_CASE(RegisterOpCode, ROP_RETURN)
+				return pRegisters[pInstruction->nLeft];
+
+			OLC_SCRIPT_VM_END()
+		}
+
+#undef OLC_SCRIPT_VM_START
+#undef OLC_SCRIPT_VM_CASE
+#undef OLC_SCRIPT_VM_NEXT
+#undef OLC_SCRIPT_VM_END
+
+		const std::vector<RegisterInstruction>& RegisterCode::GetInstructions() const
+		{
+			return m_vInstructions;
+		}
+
+		size_t RegisterCode::GetRegisterCount() const
+		{
+			return m_vConstants.size() + m_nMaxTemporaries;
+		}
+
+		/************************/
+		/* Class CompiledScript */
+		/************************/
+		CompiledScript::CompiledScript(const FlatAST& flat, ExecutionTier tier)
+		{
+			if (tier == ExecutionTier::ET_REGISTER_VM)
+				m_pRegisterCode = std::make_shared<const RegisterCode>(flat);
+			else
+				m_pBytecode = std::make_shared<const Bytecode>(flat);
+		}
+
+		int CompiledScript::Run(std::vector<int32_t>& vScratch) const
+		{
+			if (m_pRegisterCode)
+				return m_pRegisterCode->Run(vScratch);
+
+			return m_pBytecode->Run(vScratch);
+		}
+
+		ExecutionTier CompiledScript::GetExecutionTier() const
+		{
+			return m_pRegisterCode ? ExecutionTier::ET_REGISTER_VM : ExecutionTier::ET_STACK_VM;
+		}
+
+		const Bytecode* CompiledScript::GetBytecode() const
+		{
+			return m_pBytecode.get();
+		}
+
+		const RegisterCode* CompiledScript::GetRegisterCode() const
+		{
+			return m_pRegisterCode.get();
+		}
+
+
+		/*********************/
+		/* Struct SourceSpan */
+		/*********************/
+		SourceSpan SourceSpan::Cover(const SourceSpan& other) const
+		{
+			uint32_t nStart = std::min(nOffset, other.nOffset);
+			uint32_t nEnd = std::max(nOffset + nLength, other.nOffset + other.nLength);
+			return { nStart, nEnd - nStart };
+		}
+
+		/*******************/
+		/* Class LineIndex */
+		/*******************/
+		LineIndex::LineIndex() :
+			m_vLineStarts(1, 0), m_nLength(0)
+		{ }
+
+		LineIndex::LineIndex(std::string_view sScript) :
+			LineIndex()
+		{
+			Append(sScript);
+		}
+
+		void LineIndex::Append(std::string_view sChunk)
+		{
+			const char* pBegin = sChunk.data();
+			const char* pEnd = pBegin + sChunk.size();
+			const char* pNewLine = pBegin;
+
+			while (pNewLine < pEnd && (pNewLine = static_cast<const char*>(memchr(pNewLine, '\n', pEnd - pNewLine))) != nullptr) {
+				pNewLine++;
+				m_vLineStarts.push_back(m_nLength + uint32_t(pNewLine - pBegin));
+			}
+
+			m_nLength += uint32_t(sChunk.size());
+		}
+
+		SourceLocation LineIndex::GetLocation(uint32_t nOffset) const
+		{
+			// First line start behind the offset, the line before contains it
+			auto it = std::upper_bound(m_vLineStarts.begin(), m_vLineStarts.end(), nOffset);
+			size_t nLine = std::distance(m_vLineStarts.begin(), it);
+
+			return { uint32_t(nLine), nOffset - m_vLineStarts[nLine - 1] + 1 };
+		}
+
+		/***************/
+		/* Class Token */
+		/***************/
+		Token::Token(TokenType type, SourceSpan span, int32_t nValue) :
+			m_type(type), m_span(span), m_nValue(nValue)
+		{ }
+
+		Token::Token(TokenType type) :
+			Token(type, SourceSpan())
+		{ }
+
+		Token::Token() :
+			Token(TokenType::TT_NONE)
+		{ }
+
+		TokenType Token::GetTokenType() const
+		{
+			return m_type;
+		}
+
+		SourceSpan Token::GetSpan() const
+		{
+			return m_span;
+		}
+
+		int32_t Token::GetValue() const
+		{
+			return m_nValue;
+		}
+
+		uint32_t Token::GetInternId() const
+		{
+			return uint32_t(m_nValue);
+		}
+
+		std::ostream& operator<< (std::ostream& os, TokenType type)
+		{
+			switch (type) {
+			case TokenType::TT_PLUS:
+				os << "PLUS";
+				break;
+
+			case TokenType::TT_MINUS:
+				os << "MINUS";
+				break;
+
+			case TokenType::TT_MULTIPLY:
+				os << "MULTIPLY";
+				break;
+
+			case TokenType::TT_DIVIDE:
+				os << "DIVIDE";
+				break;
+
+			case TokenType::TT_LPAREN:
+				os << "LPAREN";
+				break;
+
+			case TokenType::TT_RPAREN:
+				os << "RPAREN";
+				break;
+
+			case TokenType::TT_EOF:
+				os << "EOF";
+				break;
+
+			case TokenType::TT_NUMBER:
+				os << "NUMBER";
+				break;
+
+			case TokenType::TT_IDENTIFIER:
+				os << "IDENTIFIER";
+				break;
+
+			case TokenType::TT_STRING:
+				os << "STRING";
+				break;
+
+			case TokenType::TT_NONE:
+				os << "NONE";
+				break;
+
+			default:
+				os << "UNKNOWN";
+			}
+
+			return os;
+		}
+
+		std::ostream& operator<< (std::ostream& os, const Token& token)
+		{
+			os << "Token(" << token.m_type;
+			if (token.m_type == TokenType::TT_NUMBER)
+				os << ", " << token.m_nValue;
+			else if (token.m_type == TokenType::TT_IDENTIFIER || token.m_type == TokenType::TT_STRING)
+				os << ", #" << token.GetInternId();
+
+			os << ")";
+			return os;
+		}
+
+		/***************/
+		/* Class Error */
+		/***************/
+		Error::Error(ErrorCode code, SourceSpan span, uint32_t nExpectedMask, TokenType got, char cIllegal) :
+			m_code(code), m_got(got), m_cIllegal(cIllegal), m_span(span), m_nExpectedMask(nExpectedMask)
+		{ }
+
+		std::ostream& operator<< (std::ostream& os, const Error& error)
+		{
+			os << error.GetName() << ": ";
+			error.PrintDescription(os);
+			return os;
+		}
+
+		void Error::Print(std::ostream& os, const LineIndex& lineIndex) const
+		{
+			SourceLocation location = lineIndex.GetLocation(m_span.nOffset);
+			os << GetName() << " (line " << location.nLine << ", column " << location.nColumn << "): ";
+			PrintDescription(os);
+		}
+
+		ErrorCode Error::GetCode() const
+		{
+			return m_code;
+		}
+
+		SourceSpan Error::GetSpan() const
+		{
+			return m_span;
+		}
+
+		uint32_t Error::GetExpectedMask() const
+		{
+			return m_nExpectedMask;
+		}
+
+		TokenType Error::GetGotTokenType() const
+		{
+			return m_got;
+		}
+
+		const char* Error::GetName() const
+		{
+			switch (m_code) {
+			case ErrorCode::EC_ILLEGAL_CHAR:
+			case ErrorCode::EC_LEADING_ZERO:
+				return "IllegalCharError";
+
+			case ErrorCode::EC_INTEGER_OVERFLOW:
+				return "IntegerOverflowError";
+
+			case ErrorCode::EC_UNTERMINATED_STRING:
+				return "UnterminatedStringError";
+
+			case ErrorCode::EC_UNEXPECTED_TOKEN:
+				return "UnexpectedTokenError";
+
+			case ErrorCode::EC_DIVISION_BY_ZERO:
+				return "DivisionByZeroError";
+
+			case ErrorCode::EC_ARITHMETIC_OVERFLOW:
+				return "ArithmeticOverflowError";
+
+			case ErrorCode::EC_NESTING_TOO_DEEP:
+				return "NestingTooDeepError";
+
+			default:
+				return "Error";
+			}
+		}
+
+		void Error::PrintDescription(std::ostream& os) const
+		{
+			switch (m_code) {
+			case ErrorCode::EC_ILLEGAL_CHAR:
+				os << "'" << m_cIllegal << "'";
+				break;
+
+			case ErrorCode::EC_LEADING_ZERO:
+				os << "Leading zeros are not allowed for integer values";
+				break;
+
+			case ErrorCode::EC_INTEGER_OVERFLOW:
+				os << "Integer literal does not fit into a 32-bit signed integer";
+				break;
+
+			case ErrorCode::EC_UNTERMINATED_STRING:
+				os << "String literals have to be closed on the same line";
+				break;
+
+			case ErrorCode::EC_UNEXPECTED_TOKEN: {
+				os << "Expected token ";
+
+				bool bFirst = true;
+				for (uint32_t nType = 0; nType < 32; nType++) {
+					if ((m_nExpectedMask & (1u << nType)) == 0)
+						continue;
+
+					if (!bFirst)
+						os << ", ";
+
+					os << "Token(" << TokenType(nType) << ")";
+					bFirst = false;
+				}
+
+				os << " but got Token(" << m_got << ") instead";
+				break;
+			}
+
+			case ErrorCode::EC_DIVISION_BY_ZERO:
+				os << "Division by zero";
+				break;
+
+			case ErrorCode::EC_ARITHMETIC_OVERFLOW:
+				os << "Result does not fit into a 32-bit signed integer";
+				break;
+
+			case ErrorCode::EC_NESTING_TOO_DEEP:
+				os << "Expression is nested deeper than the parser allows";
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		/*************************/
+		/* Struct ConstantResult */
+		/*************************/
+		Error ConstantResult::GetError() const
+		{
+			return Error(code, span, nExpectedMask, got, cIllegal);
+		}
+
+		/**************************/
+		/* Class IllegalCharError */
+		/**************************/
+		IllegalCharError::IllegalCharError(char cIllegal, SourceSpan span) :
+			Error(ErrorCode::EC_ILLEGAL_CHAR, span, 0, TokenType::TT_NONE, cIllegal)
+		{ }
+
+		/**************************/
+		/* Class LeadingZeroError */
+		/**************************/
+		LeadingZeroError::LeadingZeroError(SourceSpan span) :
+			Error(ErrorCode::EC_LEADING_ZERO, span)
+		{ }
+
+		/******************************/
+		/* Class UnexpectedTokenError */
+		/******************************/
+		UnexpectedTokenError::UnexpectedTokenError(std::initializer_list<TokenType> expected, const Token& got) :
+			Error(ErrorCode::EC_UNEXPECTED_TOKEN, got.GetSpan(), 0, got.GetTokenType())
+		{ 
+			for (TokenType type : expected)
+				m_nExpectedMask |= GetTokenMask(type);
+		}
+
+		/******************************/
+		/* Class IntegerOverflowError */
+		/******************************/
+		IntegerOverflowError::IntegerOverflowError(SourceSpan span) :
+			Error(ErrorCode::EC_INTEGER_OVERFLOW, span)
+		{ }
+
+		/*********************************/
+		/* Class UnterminatedStringError */
+		/*********************************/
+		UnterminatedStringError::UnterminatedStringError(SourceSpan span) :
+			Error(ErrorCode::EC_UNTERMINATED_STRING, span)
+		{ }
+
+		/*****************************/
+		/* Class NestingTooDeepError */
+		/*****************************/
+		NestingTooDeepError::NestingTooDeepError(SourceSpan span) :
+			Error(ErrorCode::EC_NESTING_TOO_DEEP, span)
+		{ }
+
+		/*****************************/
+		/* Class DivisionByZeroError */
+		/*****************************/
+		DivisionByZeroError::DivisionByZeroError(SourceSpan span) :
+			Error(ErrorCode::EC_DIVISION_BY_ZERO, span)
+		{ }
+
+		/*********************************/
+		/* Class ArithmeticOverflowError */
+		/*********************************/
+		ArithmeticOverflowError::ArithmeticOverflowError(SourceSpan span) :
+			Error(ErrorCode::EC_ARITHMETIC_OVERFLOW, span)
+		{ }
+
+		/******************/
+		/* Enum SimdLevel */
+		/******************/
+		namespace simd {
+			using ScanFunc = size_t(*)(const char* pData, size_t nPosition, size_t nLength);
+
+			inline bool IsWhitespace(char c)
+			{
+				return GetCharInfo(c).charClass == CharClass::CC_WHITESPACE;
+			}
+
+			inline bool IsDigit(char c)
+			{
+				return GetCharInfo(c).charClass == CharClass::CC_DIGIT;
+			}
+
+			// Both kernels return the position of the first character at or
+			// after nPosition that doesn't belong to the run, or nLength
+			size_t SkipWhitespaceScalar(const char* pData, size_t nPosition, size_t nLength)
+			{
+				while (nPosition < nLength && IsWhitespace(pData[nPosition]))
+					nPosition++;
+
+				return nPosition;
+			}
+
+			size_t SkipDigitsScalar(const char* pData, size_t nPosition, size_t nLength)
+			{
+				while (nPosition < nLength && IsDigit(pData[nPosition]))
+					nPosition++;
+
+				return nPosition;
+			}
+
+#ifdef OLC_SCRIPT_SIMD_X86
+			inline uint32_t CountTrailingZeros(uint32_t nMask)
+			{
+#if defined(_MSC_VER)
+				unsigned long nIndex;
+				_BitScanForward(&nIndex, nMask);
+				return nIndex;
+#else
+				return __builtin_ctz(nMask);
+#endif
+			}
 
-			case TokenType::TT_DIVIDE:
-				os << "DIVIDE";
-				break;
+			size_t SkipWhitespaceSSE2(const char* pData, size_t nPosition, size_t nLength)
+			{
+				const __m128i vSpace = _mm_set1_epi8(' ');
+				const __m128i vTab = _mm_set1_epi8('\t');
+				const __m128i vNewLine = _mm_set1_epi8('\n');
+				const __m128i vReturn = _mm_set1_epi8('\r');
+
+				while (nPosition + 16 <= nLength) {
+					__m128i vChunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + nPosition));
+					__m128i vMatch = _mm_or_si128(
+						_mm_or_si128(_mm_cmpeq_epi8(vChunk, vSpace), _mm_cmpeq_epi8(vChunk, vTab)),
+						_mm_or_si128(_mm_cmpeq_epi8(vChunk, vNewLine), _mm_cmpeq_epi8(vChunk, vReturn)));
+					uint32_t nMask = ~static_cast<uint32_t>(_mm_movemask_epi8(vMatch)) & 0xFFFF;
+					if (nMask != 0)
+						return nPosition + CountTrailingZeros(nMask);
+
+					nPosition += 16;
+				}
 
-			case TokenType::TT_LPAREN:
-				os << "LPAREN";
-				break;
+				return SkipWhitespaceScalar(pData, nPosition, nLength);
+			}
 
-			case TokenType::TT_RPAREN:
-				os << "RPAREN";
-				break;
+			size_t SkipDigitsSSE2(const char* pData, size_t nPosition, size_t nLength)
+			{
+				// Signed compares, bytes >= 0x80 are negative and never digits
+				const __m128i vBelowZero = _mm_set1_epi8('0' - 1);
+				const __m128i vAboveNine = _mm_set1_epi8('9' + 1);
+
+				while (nPosition + 16 <= nLength) {
+					__m128i vChunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + nPosition));
+					__m128i vMatch = _mm_and_si128(_mm_cmpgt_epi8(vChunk, vBelowZero), _mm_cmplt_epi8(vChunk, vAboveNine));
+					uint32_t nMask = ~static_cast<uint32_t>(_mm_movemask_epi8(vMatch)) & 0xFFFF;
+					if (nMask != 0)
+						return nPosition + CountTrailingZeros(nMask);
+
+					nPosition += 16;
+				}
 
-			case TokenType::TT_EOF:
-				os << "EOF";
-				break;
+				return SkipDigitsScalar(pData, nPosition, nLength);
+			}
 
-			case TokenType::TT_NUMBER:
-				os << "NUMBER";
-				break;
+			OLC_SCRIPT_TARGET_AVX2 size_t SkipWhitespaceAVX2(const char* pData, size_t nPosition, size_t nLength)
+			{
+				const __m256i vSpace = _mm256_set1_epi8(' ');
+				const __m256i vTab = _mm256_set1_epi8('\t');
+				const __m256i vNewLine = _mm256_set1_epi8('\n');
+				const __m256i vReturn = _mm256_set1_epi8('\r');
+
+				while (nPosition + 32 <= nLength) {
+					__m256i vChunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pData + nPosition));
+					__m256i vMatch = _mm256_or_si256(
+						_mm256_or_si256(_mm256_cmpeq_epi8(vChunk, vSpace), _mm256_cmpeq_epi8(vChunk, vTab)),
+						_mm256_or_si256(_mm256_cmpeq_epi8(vChunk, vNewLine), _mm256_cmpeq_epi8(vChunk, vReturn)));
+					uint32_t nMask = ~static_cast<uint32_t>(_mm256_movemask_epi8(vMatch));
+					if (nMask != 0)
+						return nPosition + CountTrailingZeros(nMask);
+
+					nPosition += 32;
+				}
 
-			case TokenType::TT_NONE:
-				os << "NONE";
-				break;
+				return SkipWhitespaceSSE2(pData, nPosition, nLength);
+			}
 
-			default:
-				os << "UNKNOWN";
+			OLC_SCRIPT_TARGET_AVX2 size_t SkipDigitsAVX2(const char* pData, size_t nPosition, size_t nLength)
+			{
+				const __m256i vBelowZero = _mm256_set1_epi8('0' - 1);
+				const __m256i vAboveNine = _mm256_set1_epi8('9' + 1);
+
+				while (nPosition + 32 <= nLength) {
+					__m256i vChunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pData + nPosition));
+					__m256i vMatch = _mm256_and_si256(_mm256_cmpgt_epi8(vChunk, vBelowZero), _mm256_cmpgt_epi8(vAboveNine, vChunk));
+					uint32_t nMask = ~static_cast<uint32_t>(_mm256_movemask_epi8(vMatch));
+					if (nMask != 0)
+						return nPosition + CountTrailingZeros(nMask);
+
+					nPosition += 32;
+				}
+
+				return SkipDigitsSSE2(pData, nPosition, nLength);
 			}
+#endif
 
-			if (std::holds_alternative<int32_t>(token.m_value)) {
-				int32_t nValue = std::get<int32_t>(token.m_value);
-				os << ", " << nValue;
+			struct ScanKernels {
+				SimdLevel level;
+				ScanFunc SkipWhitespace;
+				ScanFunc SkipDigits;
+			};
+
+			ScanKernels GetKernelsForLevel(SimdLevel level)
+			{
+				switch (level) {
+#ifdef OLC_SCRIPT_SIMD_X86
+				case SimdLevel::SIMD_AVX2:
+					return { SimdLevel::SIMD_AVX2, SkipWhitespaceAVX2, SkipDigitsAVX2 };
+
+				case SimdLevel::SIMD_SSE2:
+					return { SimdLevel::SIMD_SSE2, SkipWhitespaceSSE2, SkipDigitsSSE2 };
+#endif
+				default:
+					return { SimdLevel::SIMD_SCALAR, SkipWhitespaceScalar, SkipDigitsScalar };
+				}
 			}
 
-			os << ")";
-			return os;
+			ScanKernels& GetKernels()
+			{
+				static ScanKernels kernels = GetKernelsForLevel(DetectSimdLevel());
+				return kernels;
+			}
 		}
 
-		/***************/
-		/* Class Error */
-		/***************/
-		Error::Error(std::string sErrorName, std::string sErrorDescription) :
-			m_sErrorName(sErrorName), m_sErrorDescription(sErrorDescription)
-		{ }
+		SimdLevel DetectSimdLevel()
+		{
+#ifdef OLC_SCRIPT_SIMD_X86
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] >= 7) {
+				__cpuid(info, 1);
+				bool bOSXSave = (info[2] & (1 << 27)) != 0;
+				bool bAVX = (info[2] & (1 << 28)) != 0;
+
+				// The OS also has to save the YMM registers on context switches
+				if (bOSXSave && bAVX && (_xgetbv(0) & 0x6) == 0x6) {
+					__cpuidex(info, 7, 0);
+					if (info[1] & (1 << 5))
+						return SimdLevel::SIMD_AVX2;
+				}
+			}
+#else
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2"))
+				return SimdLevel::SIMD_AVX2;
+#endif
+			return SimdLevel::SIMD_SSE2;
+#else
+			return SimdLevel::SIMD_SCALAR;
+#endif
+		}
 
-		std::ostream& operator<< (std::ostream& os, const Error& error)
+		SimdLevel GetSimdLevel()
 		{
-			os << error.m_sErrorName << ": " << error.m_sErrorDescription;
-			return os;
+			return simd::GetKernels().level;
 		}
 
-		/**************************/
-		/* Class IllegalCharError */
-		/**************************/
-		IllegalCharError::IllegalCharError(std::string sErrorDescription) :
-			Error("IllegalCharError", sErrorDescription)
+		SimdLevel SetSimdLevel(SimdLevel level)
+		{
+			SimdLevel detected = DetectSimdLevel();
+			if (level > detected)
+				level = detected;
+
+			simd::GetKernels() = simd::GetKernelsForLevel(level);
+			return level;
+		}
+
+		/*********************/
+		/* Class InternTable */
+		/*********************/
+		uint32_t InternTable::Intern(std::string_view sText)
+		{
+			auto it = m_mapIds.find(sText);
+			if (it != m_mapIds.end())
+				return it->second;
+
+			uint32_t nId = uint32_t(m_dqStrings.size());
+			m_dqStrings.emplace_back(sText);
+			m_mapIds.emplace(m_dqStrings.back(), nId);
+
+			return nId;
+		}
+
+		std::string_view InternTable::GetString(uint32_t nId) const
+		{
+			return m_dqStrings[nId];
+		}
+
+		size_t InternTable::GetSize() const
+		{
+			return m_dqStrings.size();
+		}
+
+		/****************************/
+		/* Class StreamSourceReader */
+		/****************************/
+		StreamSourceReader::StreamSourceReader(std::streambuf& buffer) :
+			m_buffer(buffer)
 		{ }
 
-		/******************************/
-		/* Class UnexpectedTokenError */
-		/******************************/
-		UnexpectedTokenError::UnexpectedTokenError(std::vector<TokenType> vExpected, TokenType got) :
-			Error("UnexpectedTokenError", "")
-		{ 
-			std::ostringstream ossDetail;
+		size_t StreamSourceReader::Read(char* pBuffer, size_t nSize)
+		{
+			return size_t(m_buffer.sgetn(pBuffer, std::streamsize(nSize)));
+		}
 
-			ossDetail << "Expected token ";
-			for (auto& expected : vExpected) {
-				ossDetail << expected;
+		/********************/
+		/* Class MappedFile */
+		/********************/
+		MappedFile::MappedFile(const std::string& sPath) :
+			m_bOpen(false), m_pData(nullptr), m_nSize(0), m_hFile(nullptr), m_hMapping(nullptr)
+		{
+#if defined(OLC_SCRIPT_MMAP_WIN32)
+			// Not opened for sequential scans, TokenizeParallel reads the pieces concurrently
+			HANDLE hFile = CreateFileA(sPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (hFile == INVALID_HANDLE_VALUE)
+				return;
+
+			m_hFile = hFile;
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(hFile, &size))
+				return;
+
+			m_nSize = size_t(size.QuadPart);
+			m_bOpen = true;
+
+			// Empty files can't be mapped
+			if (m_nSize == 0)
+				return;
+
+			m_hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (m_hMapping == nullptr) {
+				m_bOpen = false;
+				return;
+			}
 
-				if (&expected != &vExpected.back()) {
-					ossDetail << ", ";
+			m_pData = static_cast<const char*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+			m_bOpen = m_pData != nullptr;
+#elif defined(OLC_SCRIPT_MMAP_POSIX)
+			int fd = open(sPath.c_str(), O_RDONLY);
+			if (fd < 0)
+				return;
+
+			struct stat info;
+			if (fstat(fd, &info) == 0) {
+				m_nSize = size_t(info.st_size);
+				m_bOpen = true;
+
+				// Empty files can't be mapped
+				if (m_nSize > 0) {
+					void* pMapping = mmap(nullptr, m_nSize, PROT_READ, MAP_PRIVATE, fd, 0);
+					if (pMapping != MAP_FAILED) {
+						// TokenizeParallel reads the whole file at several offsets
+						// at once, so all of it is requested up front
+						madvise(pMapping, m_nSize, MADV_WILLNEED);
+						m_pData = static_cast<const char*>(pMapping);
+					}
+					else {
+						m_bOpen = false;
+					}
 				}
 			}
 
-			ossDetail << " but got " << got << " instead";
+			// The mapping stays valid after the descriptor is closed
+			close(fd);
+#else
+			std::ifstream ifs(sPath, std::ios::binary);
+			if (!ifs.is_open())
+				return;
+
+			m_sFallback.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+			m_pData = m_sFallback.data();
+			m_nSize = m_sFallback.size();
+			m_bOpen = true;
+#endif
+		}
+
+		MappedFile::~MappedFile()
+		{
+#if defined(OLC_SCRIPT_MMAP_WIN32)
+			if (m_pData != nullptr)
+				UnmapViewOfFile(m_pData);
+
+			if (m_hMapping != nullptr)
+				CloseHandle(m_hMapping);
+
+			if (m_hFile != nullptr)
+				CloseHandle(m_hFile);
+#elif defined(OLC_SCRIPT_MMAP_POSIX)
+			if (m_pData != nullptr)
+				munmap(const_cast<char*>(m_pData), m_nSize);
+#endif
+		}
+
+		bool MappedFile::IsOpen() const
+		{
+			return m_bOpen;
+		}
 
-			m_sErrorDescription = ossDetail.str();
+		std::string_view MappedFile::GetView() const
+		{
+			return std::string_view(m_pData, m_pData != nullptr ? m_nSize : 0);
 		}
 
 		/***************/
 		/* Class Lexer */
 		/***************/
-		Lexer::Lexer(std::string sScript) :
-			m_isScript(sScript)
+		Lexer::Lexer(std::string_view sScript) :
+			m_cCurrentChar('\0'), m_nPosition(0), m_sScript(sScript), m_pInternTable(nullptr),
+			m_nWindowOffset(0), m_pReader(nullptr), m_bReaderDone(true), m_nChunkSize(0)
 		{ 
-			Advance();
+			if (!m_sScript.empty())
+				m_cCurrentChar = m_sScript[0];
+		}
+
+		Lexer::Lexer(std::string_view sScript, InternTable& internTable, size_t nBaseOffset) :
+			Lexer(sScript)
+		{
+			m_pInternTable = &internTable;
+			m_nWindowOffset = nBaseOffset;
+		}
+
+		Lexer::Lexer(const char* pScript, size_t nLength) :
+			Lexer(std::string_view(pScript, nLength))
+		{ }
+
+		Lexer::Lexer(SourceReader& reader, InternTable& internTable, size_t nChunkSize) :
+			Lexer(std::string_view(), internTable)
+		{
+			m_pReader = &reader;
+			m_bReaderDone = false;
+			m_nChunkSize = nChunkSize > 0 ? nChunkSize : 1;
 		}
 
 		void Lexer::Advance()
 		{
-			m_cCurrentChar = m_isScript.get();
+			if (m_nPosition < m_sScript.size())
+				m_nPosition++;
 
-			if (m_isScript.eof()) {
-				m_cCurrentChar = '\0';
-			}
+			m_cCurrentChar = m_nPosition < m_sScript.size() ? m_sScript[m_nPosition] : '\0';
 		}
 
-		LexerReturn Lexer::GetNextToken()
+		void Lexer::SetPosition(size_t nPosition)
 		{
-			static const std::string digits("123456789");
-			Token token;
+			m_nPosition = nPosition < m_sScript.size() ? nPosition : m_sScript.size();
+			m_cCurrentChar = m_nPosition < m_sScript.size() ? m_sScript[m_nPosition] : '\0';
+		}
 
-			while (m_cCurrentChar != '\0' && token.GetTokenType() == TokenType::TT_NONE) {
-				if (m_cCurrentChar == '\t' || m_cCurrentChar == ' ') {
-					// Ignore whitespaces
-					Advance();
-					continue;
-				}
-				else if (m_cCurrentChar == '+') {
-					token.SetTokenType(TokenType::TT_PLUS);
-				}
-				else if (m_cCurrentChar == '-') {
-					token.SetTokenType(TokenType::TT_MINUS);
-				}
-				else if (m_cCurrentChar == '*') {
-					token.SetTokenType(TokenType::TT_MULTIPLY);
-				}
-				else if (m_cCurrentChar == '/') {
-					token.SetTokenType(TokenType::TT_DIVIDE);
-				}
-				else if (m_cCurrentChar == '(') {
-					token.SetTokenType(TokenType::TT_LPAREN);
-				}
-				else if (m_cCurrentChar == ')') {
-					token.SetTokenType(TokenType::TT_RPAREN);
-				}
-				else if (isdigit(m_cCurrentChar)) {
-					// Handle number tokens
-					return GenerateNumberToken();
-				}
-				else {
-					// Illegal character found!
-					return IllegalCharError("'" + std::string(1, m_cCurrentChar) + "'");
+		uint32_t Lexer::GetOffset(size_t nPosition) const
+		{
+			return uint32_t(m_nWindowOffset + nPosition);
+		}
+
+		bool Lexer::NeedsMoreInput() const
+		{
+			return !m_bReaderDone && m_nPosition >= m_sScript.size();
+		}
+
+		void Lexer::Refill(size_t nKeepFrom)
+		{
+			// Everything in front of the current token is never looked at again
+			size_t nKeep = m_sScript.size() - nKeepFrom;
+			if (nKeep > 0)
+				memmove(m_vWindow.data(), m_vWindow.data() + nKeepFrom, nKeep);
+			m_nWindowOffset += nKeepFrom;
+
+			// Only tokens longer than a chunk grow the window
+			if (m_vWindow.size() < nKeep + m_nChunkSize)
+				m_vWindow.resize(nKeep + m_nChunkSize);
+
+			size_t nRead = m_pReader->Read(m_vWindow.data() + nKeep, m_nChunkSize);
+			if (nRead == 0)
+				m_bReaderDone = true;
+
+			m_lineIndex.Append(std::string_view(m_vWindow.data() + nKeep, nRead));
+			m_sScript = std::string_view(m_vWindow.data(), nKeep + nRead);
+			SetPosition(0);
+		}
+
+		const LineIndex& Lexer::GetLineIndex() const
+		{
+			return m_lineIndex;
+		}
+
+		LexerReturn Lexer::GetNextToken()
+		{
+			while (true) {
+				// Ignore whitespaces, the whole run is skipped at once. A run
+				// reaching the window border is dropped by the refill, so only
+				// unfinished tokens are kept across chunks.
+				if (simd::IsWhitespace(m_cCurrentChar)) {
+					SetPosition(simd::GetKernels().SkipWhitespace(m_sScript.data(), m_nPosition, m_sScript.size()));
+					if (NeedsMoreInput()) {
+						Refill(m_nPosition);
+						continue;
+					}
 				}
 
+				size_t nTokenStart = m_nPosition;
+				LexerReturn ret = ScanToken();
+
+				// A token ending at the window border might continue in the next
+				// chunk, so it is scanned again once more input is available
+				if (!NeedsMoreInput())
+					return ret;
+
+				Refill(nTokenStart);
+			}
+		}
+
+		LexerReturn Lexer::ScanToken()
+		{
+			// GetNextToken already skipped whitespaces
+			const CharInfo& info = GetCharInfo(m_cCurrentChar);
+
+			switch (info.charClass) {
+			case CharClass::CC_PUNCTUATOR: {
+				Token token(info.tokenType, { GetOffset(m_nPosition), 1 });
 				Advance();
+				return token;
 			}
 
-			if (m_cCurrentChar == '\0' && token.GetTokenType() == TokenType::TT_NONE) {
+			case CharClass::CC_DIGIT:
+				// Handle number tokens
+				return GenerateNumberToken();
+
+			case CharClass::CC_IDENTIFIER:
+				return GenerateIdentifierToken();
+
+			case CharClass::CC_QUOTE:
+				return GenerateStringToken();
+
+			case CharClass::CC_END:
 				// End of script reached
-				token.SetTokenType(TokenType::TT_EOF);
-			}
+				return Token(TokenType::TT_EOF, { GetOffset(m_nPosition), 0 });
 
-			return token;
+			default:
+				// Illegal character found!
+				return IllegalCharError(m_cCurrentChar, { GetOffset(m_nPosition), 1 });
+			}
 		}
 
 		LexerReturn Lexer::GenerateNumberToken()
 		{
 			if (m_cCurrentChar == '0') {
-				IllegalCharError error("Leading zeros are not allowed for integer values");
-				return LexerReturn(error);
+				return LeadingZeroError({ GetOffset(m_nPosition), 1 });
 			}
 
-			std::string sNumber(1, m_cCurrentChar);
-			Advance();
+			size_t nStart = m_nPosition;
+			SetPosition(simd::GetKernels().SkipDigits(m_sScript.data(), m_nPosition, m_sScript.size()));
+			if (NeedsMoreInput())
+				return Token();
+
+			// Decode the digits in place, from_chars neither allocates nor throws
+			const char* pBegin = m_sScript.data() + nStart;
+			const char* pEnd = m_sScript.data() + m_nPosition;
+			SourceSpan span = { GetOffset(nStart), uint32_t(m_nPosition - nStart) };
+			int32_t nNumberValue = 0;
+
+			std::from_chars_result result = std::from_chars(pBegin, pEnd, nNumberValue);
+			if (result.ec == std::errc::result_out_of_range)
+				return IntegerOverflowError(span);
 
-			while (m_cCurrentChar != '\0' && isdigit(m_cCurrentChar)) {
-				sNumber += std::string(1, m_cCurrentChar);
+			// Identifiers can't start with a digit, so reject suffixes like "10a"
+			if (GetCharInfo(m_cCurrentChar).charClass == CharClass::CC_IDENTIFIER)
+				return IllegalCharError(m_cCurrentChar, { GetOffset(m_nPosition), 1 });
+
+			return Token(TokenType::TT_NUMBER, span, nNumberValue);
+		}
+
+		LexerReturn Lexer::GenerateIdentifierToken()
+		{
+			size_t nStart = m_nPosition;
+
+			CharClass charClass = CharClass::CC_IDENTIFIER;
+			while (charClass == CharClass::CC_IDENTIFIER || charClass == CharClass::CC_DIGIT) {
 				Advance();
+				charClass = GetCharInfo(m_cCurrentChar).charClass;
+			}
+
+			// Don't intern a name that is cut off by the window border
+			if (NeedsMoreInput())
+				return Token();
+
+			std::string_view sIdentifier = m_sScript.substr(nStart, m_nPosition - nStart);
+			uint32_t nId = GetInternTable().Intern(sIdentifier);
+
+			return Token(TokenType::TT_IDENTIFIER, { GetOffset(nStart), uint32_t(sIdentifier.size()) }, int32_t(nId));
+		}
+
+		LexerReturn Lexer::GenerateStringToken()
+		{
+			size_t nStart = m_nPosition;
+			size_t nContentStart = nStart + 1;
+
+			// Strings have no escape sequences yet and can't span lines
+			size_t nEnd = m_sScript.find_first_of("'\n", nContentStart);
+			if (nEnd == std::string_view::npos || m_sScript[nEnd] != '\'') {
+				SetPosition(nEnd);
+				if (NeedsMoreInput())
+					return Token();
+
+				return UnterminatedStringError({ GetOffset(nStart), uint32_t(m_nPosition - nStart) });
+			}
+
+			uint32_t nId = GetInternTable().Intern(m_sScript.substr(nContentStart, nEnd - nContentStart));
+			SetPosition(nEnd + 1);
+
+			return Token(TokenType::TT_STRING, { GetOffset(nStart), uint32_t(m_nPosition - nStart) }, int32_t(nId));
+		}
+
+		InternTable& Lexer::GetInternTable()
+		{
+			if (m_pInternTable == nullptr) {
+				m_pOwnInternTable = std::make_unique<InternTable>();
+				m_pInternTable = m_pOwnInternTable.get();
+			}
+
+			return *m_pInternTable;
+		}
+
+		TokenizerReturn Lexer::TokenizeParallel(std::string_view sScript, InternTable& internTable, size_t nThreads, size_t nMinPieceSize)
+		{
+			if (nThreads == 0)
+				nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+			// Serial lexing ends at the first null character, so no piece may
+			// start behind it
+			sScript = sScript.substr(0, sScript.find('\0'));
+
+			size_t nPieces = std::min(nThreads, std::max<size_t>(1, sScript.size() / std::max<size_t>(1, nMinPieceSize)));
+			if (nPieces <= 1)
+				return Lexer(sScript, internTable).Tokenize();
+
+			// Move every split point behind the next line break
+			std::vector<size_t> vBoundaries = { 0 };
+			for (size_t i = 1; i < nPieces; i++) {
+				size_t nSplit = std::max(sScript.size() * i / nPieces, vBoundaries.back());
+				size_t nNewLine = sScript.find('\n', nSplit);
+				if (nNewLine == std::string_view::npos)
+					break;
+
+				if (nNewLine + 1 > vBoundaries.back())
+					vBoundaries.push_back(nNewLine + 1);
+			}
+			vBoundaries.push_back(sScript.size());
+			nPieces = vBoundaries.size() - 1;
+
+			// Every piece interns into a table of its own, the ids are mapped
+			// to the shared table while stitching the pieces together
+			std::vector<InternTable> vInternTables(nPieces);
+			std::vector<TokenizerReturn> vResults(nPieces);
+
+			auto LexPiece = [&](size_t nPiece) {
+				size_t nStart = vBoundaries[nPiece];
+				Lexer lexer(sScript.substr(nStart, vBoundaries[nPiece + 1] - nStart), vInternTables[nPiece], nStart);
+				vResults[nPiece] = lexer.Tokenize();
+			};
+
+			std::vector<std::thread> vThreads;
+			for (size_t i = 1; i < nPieces; i++)
+				vThreads.emplace_back(LexPiece, i);
+
+			LexPiece(0);
+			for (auto& thread : vThreads)
+				thread.join();
+
+			size_t nTotalTokens = 1;
+			for (auto& result : vResults) {
+				// The first error of the first failing piece is the first error of the script
+				if (std::holds_alternative<Error>(result))
+					return std::get<Error>(result);
+
+				nTotalTokens += std::get<TokenBuffer>(result).size() - 1;
+			}
+
+			TokenBuffer vTokens;
+			vTokens.reserve(nTotalTokens);
+			std::vector<uint32_t> vIdMap;
+
+			for (size_t nPiece = 0; nPiece < nPieces; nPiece++) {
+				vIdMap.clear();
+				for (size_t nId = 0; nId < vInternTables[nPiece].GetSize(); nId++)
+					vIdMap.push_back(internTable.Intern(vInternTables[nPiece].GetString(uint32_t(nId))));
+
+				const TokenBuffer& vPieceTokens = std::get<TokenBuffer>(vResults[nPiece]);
+				for (size_t i = 0; i + 1 < vPieceTokens.size(); i++) {
+					const Token& token = vPieceTokens[i];
+					if (token.GetTokenType() == TokenType::TT_IDENTIFIER || token.GetTokenType() == TokenType::TT_STRING)
+						vTokens.emplace_back(token.GetTokenType(), token.GetSpan(), int32_t(vIdMap[token.GetInternId()]));
+					else
+						vTokens.push_back(token);
+				}
+			}
+
+			// Only the EOF token of the last piece is kept
+			vTokens.push_back(std::get<TokenBuffer>(vResults.back()).back());
+			return vTokens;
+		}
+
+		TokenizerReturn Lexer::Tokenize()
+		{
+			TokenBuffer vTokens;
+
+			while (true) {
+				LexerReturn ret = GetNextToken();
+				if (std::holds_alternative<Error>(ret))
+					return std::get<Error>(ret);
+
+				vTokens.push_back(std::get<Token>(ret));
+				if (vTokens.back().GetTokenType() == TokenType::TT_EOF)
+					break;
 			}
 
-			int32_t nNumberValue = std::stoi(sNumber);
-			return Token(TokenType::TT_NUMBER, nNumberValue);
+			return vTokens;
 		}
 
 		/****************/
 		/* Class Parser */
 		/****************/
-		Parser::Parser(Lexer& lexer)
-			: m_lexer(lexer)
+		Parser::Parser(const TokenBuffer& vTokens)
+			: m_vTokens(vTokens), m_nCurrentToken(0), m_nMaxDepth(1000000), m_bConstantFolding(true)
 		{ }
 
+		void Parser::SetMaxDepth(size_t nMaxDepth)
+		{
+			m_nMaxDepth = nMaxDepth;
+		}
+
+		void Parser::SetConstantFolding(bool bEnabled)
+		{
+			m_bConstantFolding = bEnabled;
+		}
+
+		const Token& Parser::GetCurrentToken() const
+		{
+			return m_vTokens[m_nCurrentToken];
+		}
+
 		std::optional<Error> Parser::Eat(TokenType type)
 		{
-			if (m_currentToken.GetTokenType() == type) {
-				LexerReturn ret = m_lexer.GetNextToken();
-				if (std::holds_alternative<Error>(ret))
-					return std::get<Error>(ret);
+			if (GetCurrentToken().GetTokenType() == type) {
+				// Never move past the closing TT_EOF token
+				if (m_nCurrentToken + 1 < m_vTokens.size())
+					m_nCurrentToken++;
 
-				m_currentToken = std::get<Token>(ret);
 				return std::nullopt;
 			}
 			else {
-				return UnexpectedTokenError({ type }, m_currentToken.GetTokenType());
+				return UnexpectedTokenError({ type }, GetCurrentToken());
 			}
 		}
 
 		ParserReturn Parser::Parse()
 		{
-			// Current token is firstly set to TT_NONE
-			std::optional<Error> error = Eat(TokenType::TT_NONE);
-			if (error)
-				return *error;
+			if (m_vTokens.empty() || m_vTokens.back().GetTokenType() != TokenType::TT_EOF)
+				return UnexpectedTokenError({ TokenType::TT_EOF }, Token());
+
+			m_nCurrentToken = 0;
+			m_arithmeticError.reset();
+
+			// Only numbers and operators add a node, at most one each. The first
+			// block is capped since the nesting limit may still reject the script,
+			// larger trees continue in doubling blocks.
+			constexpr size_t nMaxReserve = 1024 * 1024;
+			size_t nNodeBytes = 0;
+			for (const Token& token : m_vTokens) {
+				const OperatorInfo& info = GetOperatorInfo(token.GetTokenType());
+				if (token.GetTokenType() == TokenType::TT_NUMBER)
+					nNodeBytes += sizeof(ASTNumNode);
+				else if (info.nBinaryPrecedence > 0 || info.nUnaryPrecedence > 0)
+					nNodeBytes += sizeof(ASTBinOpNode);
+			}
 
-			ParserReturn ret = Expr();
-			if (std::holds_alternative<Error>(ret))
-				return std::get<Error>(ret);
+			m_arena = ASTArena();
+			m_arena.Reserve(std::min(nNodeBytes, nMaxReserve));
 
-			error = Eat(TokenType::TT_EOF);
-			if (error)
-				return *error;
+			NodeReturn ret = Expression();
+			if (!ret.HasValue())
+				return ret.GetError();
 
-			return ret;
+			// Like EvaluateConstant, syntax errors win over arithmetic errors
+			if (m_arithmeticError)
+				return *m_arithmeticError;
+
+			return AST(std::move(m_arena), ret.GetValue());
 		}
 
-		ParserReturn Parser::Factor()
+		std::optional<Error> Parser::PushOperator(const Token& token, uint8_t nMinPrecedence, bool bUnary)
 		{
-			Token token = m_currentToken;
-			TokenType curTokenType = token.GetTokenType();
-			std::optional<Error> error;
-			ParserReturn ret;
-
-			switch (curTokenType)
-			{
-			case TokenType::TT_PLUS:
-			case TokenType::TT_MINUS:
-				error = Eat(curTokenType);
-				if (error)
-					return *error;
+			if (m_vOperators.size() >= m_nMaxDepth)
+				return NestingTooDeepError(token.GetSpan());
 
-				ret = Factor();
-				if (std::holds_alternative<Error>(ret))
-					return std::get<Error>(ret);
+			m_vOperators.push_back({ token, nMinPrecedence, bUnary });
+			return Eat(token.GetTokenType());
+		}
 
-				return std::make_shared<ASTUnaryOpNode>(token, std::get<ASTNodeSharedPtr>(ret));
+		void Parser::Reduce()
+		{
+			PendingOperator op = m_vOperators.back();
+			m_vOperators.pop_back();
 
-			case TokenType::TT_NUMBER:
-				error = Eat(curTokenType);
-				if (error)
-					return *error;
+			ASTNode* node = m_vOperands.back();
+			m_vOperands.pop_back();
 
-				return std::make_shared<ASTNumNode>(token);
+			if (op.bUnary) {
+				m_vOperands.push_back(MakeUnaryNode(op.token, node));
+			}
+			else {
+				ASTNode* leftNode = m_vOperands.back();
+				m_vOperands.back() = MakeBinaryNode(leftNode, op.token, node);
+			}
+		}
 
-			case TokenType::TT_LPAREN:
-				error = Eat(TokenType::TT_LPAREN);
-				if (error)
-					return *error;
+		ASTNode* Parser::MakeUnaryNode(const Token& op, ASTNode* node)
+		{
+			std::optional<int> nConstant = m_bConstantFolding ? node->GetConstant() : std::nullopt;
+			if (nConstant) {
+				std::optional<int64_t> nValue;
+
+				switch (op.GetTokenType())
+				{
+				case TokenType::TT_PLUS:
+					nValue = int64_t(*nConstant);
+					break;
+
+				case TokenType::TT_MINUS:
+					nValue = -int64_t(*nConstant);
+					break;
+
+				default:
+					break;
+				}
 
-				ret = Expr();
-				if (std::holds_alternative<Error>(ret))
-					return std::get<Error>(ret);
+				// The interpreter would overflow, so it is reported instead
+				if (nValue && (*nValue < INT32_MIN || *nValue > INT32_MAX))
+					FailArithmetic(ArithmeticOverflowError(op.GetSpan()));
+				else if (nValue)
+					return m_arena.Create<ASTNumNode>(Token(TokenType::TT_NUMBER, op.GetSpan().Cover(node->GetSpan()), int32_t(*nValue)));
+			}
 
-				error = Eat(TokenType::TT_RPAREN);
-				if (error)
-					return *error;
+			return m_arena.Create<ASTUnaryOpNode>(op, node);
+		}
 
-				return std::get<ASTNodeSharedPtr>(ret);
+		ASTNode* Parser::MakeBinaryNode(ASTNode* leftNode, const Token& op, ASTNode* rightNode)
+		{
+			std::optional<int> nLeft = m_bConstantFolding ? leftNode->GetConstant() : std::nullopt;
+			std::optional<int> nRight = m_bConstantFolding ? rightNode->GetConstant() : std::nullopt;
+
+			if (nLeft && nRight) {
+				std::optional<int64_t> nValue;
+
+				switch (op.GetTokenType())
+				{
+				case TokenType::TT_PLUS:
+					nValue = int64_t(*nLeft) + *nRight;
+					break;
+
+				case TokenType::TT_MINUS:
+					nValue = int64_t(*nLeft) - *nRight;
+					break;
+
+				case TokenType::TT_MULTIPLY:
+					nValue = int64_t(*nLeft) * *nRight;
+					break;
+
+				case TokenType::TT_DIVIDE:
+					// Division by zero would trap in the interpreter
+					if (*nRight == 0)
+						FailArithmetic(DivisionByZeroError(op.GetSpan()));
+					else
+						nValue = int64_t(*nLeft) / *nRight;
+					break;
+
+				default:
+					break;
+				}
 
-			default:
-				return UnexpectedTokenError({ TokenType::TT_LPAREN, TokenType::TT_NUMBER }, token.GetTokenType());
+				// The interpreter would overflow, so it is reported instead
+				if (nValue && (*nValue < INT32_MIN || *nValue > INT32_MAX))
+					FailArithmetic(ArithmeticOverflowError(op.GetSpan()));
+				else if (nValue)
+					return m_arena.Create<ASTNumNode>(Token(TokenType::TT_NUMBER, leftNode->GetSpan().Cover(rightNode->GetSpan()), int32_t(*nValue)));
 			}
+
+			return m_arena.Create<ASTBinOpNode>(leftNode, op, rightNode);
 		}
 
-		ParserReturn Parser::Term()
+		void Parser::FailArithmetic(const Error& error)
 		{
+			if (!m_arithmeticError)
+				m_arithmeticError = error;
+		}
+
+		NodeReturn Parser::Expression()
+		{
+			m_vOperators.clear();
+			m_vOperands.clear();
 			std::optional<Error> error;
 
-			ParserReturn ret = Factor();
-			if (std::holds_alternative<Error>(ret))
-				return std::get<Error>(ret);
+			while (true) {
+				// Prefix position: unary operators and opening parentheses
+				// are stacked until an operand is found
+				const Token& token = GetCurrentToken();
+				TokenType curTokenType = token.GetTokenType();
+
+				if (GetOperatorInfo(curTokenType).nUnaryPrecedence > 0) {
+					error = PushOperator(token, GetOperatorInfo(curTokenType).nUnaryPrecedence, true);
+					if (error)
+						return *error;
 
-			ASTNodeSharedPtr node = std::get<ASTNodeSharedPtr>(ret);
+					continue;
+				}
 
-			while (m_currentToken.GetTokenType() == TokenType::TT_MULTIPLY || m_currentToken.GetTokenType() == TokenType::TT_DIVIDE) {
-				Token op = m_currentToken;
-				error = Eat(op.GetTokenType());
+				switch (curTokenType)
+				{
+				case TokenType::TT_LPAREN:
+					// Parentheses start over at the lowest precedence
+					error = PushOperator(token, 0, false);
+					if (error)
+						return *error;
 
-				if (error)
-					return *error;
+					continue;
 
-				ret = Factor();
-				if (std::holds_alternative<Error>(ret))
-					return std::get<Error>(ret);
+				case TokenType::TT_NUMBER:
+					error = Eat(curTokenType);
+					if (error)
+						return *error;
+
+					m_vOperands.push_back(m_arena.Create<ASTNumNode>(token));
+					break;
+
+				default:
+					return UnexpectedTokenError({ TokenType::TT_LPAREN, TokenType::TT_NUMBER }, token);
+				}
 
-				ASTNodeSharedPtr rightNode = std::get<ASTNodeSharedPtr>(ret);
-				node = std::make_shared<ASTBinOpNode>(node, op, rightNode);
+				// Infix position: every operator that doesn't take the next
+				// operator into its operand is complete
+				while (true) {
+					const Token& op = GetCurrentToken();
+					const OperatorInfo& info = GetOperatorInfo(op.GetTokenType());
+
+					while (!m_vOperators.empty() && m_vOperators.back().token.GetTokenType() != TokenType::TT_LPAREN
+						&& (info.nBinaryPrecedence == 0 || info.nBinaryPrecedence < m_vOperators.back().nMinPrecedence))
+						Reduce();
+
+					if (info.nBinaryPrecedence > 0) {
+						// Left associative operators only take tighter binding operators
+						// into their right operand
+						error = PushOperator(op, info.bRightAssociative ? info.nBinaryPrecedence : info.nBinaryPrecedence + 1, false);
+						if (error)
+							return *error;
+
+						break;
+					}
+
+					if (m_vOperators.empty()) {
+						error = Eat(TokenType::TT_EOF);
+						if (error)
+							return *error;
+
+						return m_vOperands.back();
+					}
+
+					error = Eat(TokenType::TT_RPAREN);
+					if (error)
+						return *error;
+
+					m_vOperators.pop_back();
+				}
 			}
+		}
+
+		/*********************/
+		/* Class ScriptCache */
+		/*********************/
+		ScriptCache::ScriptCache(size_t nCapacity, size_t nMaxBytes)
+			: m_nCapacity(nCapacity), m_nMaxBytes(nMaxBytes), m_nBytes(0)
+		{ }
 
-			return node;
+		bool ScriptCache::Accepts(std::string_view sScript) const
+		{
+			return m_nCapacity > 0 && sScript.size() <= m_nMaxBytes;
 		}
 
-		ParserReturn Parser::Expr()
+		const CompilerReturn* ScriptCache::Find(std::string_view sScript)
 		{
-			std::optional<Error> error;
+			auto it = m_mapEntries.find(sScript);
+			if (it == m_mapEntries.end())
+				return nullptr;
+
+			// Splicing keeps the entry and its key in place
+			m_lEntries.splice(m_lEntries.begin(), m_lEntries, it->second);
+			return &it->second->result;
+		}
+
+		const CompilerReturn& ScriptCache::Insert(std::string_view sScript, CompilerReturn&& result)
+		{
+			auto it = m_mapEntries.find(sScript);
+			if (it != m_mapEntries.end()) {
+				it->second->result = std::move(result);
+				m_lEntries.splice(m_lEntries.begin(), m_lEntries, it->second);
+				return it->second->result;
+			}
 
-			ParserReturn ret = Term();
-			if (std::holds_alternative<Error>(ret))
-				return std::get<Error>(ret);
+			m_lEntries.push_front({ std::string(sScript), std::move(result) });
+			m_mapEntries.emplace(m_lEntries.front().sScript, m_lEntries.begin());
+			m_nBytes += sScript.size();
+			Evict();
 
-			ASTNodeSharedPtr node = std::get<ASTNodeSharedPtr>(ret);
+			return m_lEntries.front().result;
+		}
 
-			while (m_currentToken.GetTokenType() == TokenType::TT_PLUS || m_currentToken.GetTokenType() == TokenType::TT_MINUS) {
-				Token op = m_currentToken;
+		void ScriptCache::SetCapacity(size_t nCapacity)
+		{
+			m_nCapacity = nCapacity;
+			Evict();
+		}
 
-				error = Eat(op.GetTokenType());
-				if (error)
-					return *error;
+		void ScriptCache::SetMaxBytes(size_t nMaxBytes)
+		{
+			m_nMaxBytes = nMaxBytes;
+			Evict();
+		}
 
-				ret = Term();
-				if (std::holds_alternative<Error>(ret))
-					return std::get<Error>(ret);
+		size_t ScriptCache::GetSize() const
+		{
+			return m_lEntries.size();
+		}
 
-				ASTNodeSharedPtr rightNode = std::get<ASTNodeSharedPtr>(ret);
-				node = std::make_shared<ASTBinOpNode>(node, op, rightNode);
-			}
+		void ScriptCache::Clear()
+		{
+			m_mapEntries.clear();
+			m_lEntries.clear();
+			m_nBytes = 0;
+		}
 
-			return node;
+		void ScriptCache::Evict()
+		{
+			// An accepted script fits on its own, so Insert never evicts the newest entry
+			while (!m_lEntries.empty() && (m_lEntries.size() > m_nCapacity || m_nBytes > m_nMaxBytes)) {
+				m_nBytes -= m_lEntries.back().sScript.size();
+				m_mapEntries.erase(m_lEntries.back().sScript);
+				m_lEntries.pop_back();
+			}
 		}
 	}
 }